@@ -2,6 +2,8 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <queue>
 #include <memory>
 #include <stdexcept>
@@ -12,10 +14,33 @@
 #include <fstream>
 #include <sstream>
 #include <filesystem> // Required for file system operations
+#include <string_view>
+#include <charconv>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <array>
+#include <tuple>
+#include <numeric>
+#include <functional>
+#include <exception>
+#include <iterator>
+#include <random>
+#include <chrono>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h> // getrusage for peak RSS in the benchmark
+#endif
 
 // Use standard namespace for cleaner code
 using namespace std;
 
+// Build with -DMAPS_STATS=0 to compile the hot-path instrumentation out entirely
+#ifndef MAPS_STATS
+#define MAPS_STATS 1
+#endif
+
 // Define M_PI if not available
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -83,6 +108,20 @@ TransportationType stringToTransportType(const string& s) {
     return TransportationType::ANY;
 }
 
+// Great-circle distance in kilometres between two lat/lon points (degrees).
+double haversineKm(double lat1, double lon1, double lat2, double lon2) {
+    const double R = 6371;
+    lat1 = lat1 * M_PI / 180.0;
+    lon1 = lon1 * M_PI / 180.0;
+    lat2 = lat2 * M_PI / 180.0;
+    lon2 = lon2 * M_PI / 180.0;
+    double dlon = lon2 - lon1;
+    double dlat = lat2 - lat1;
+    double val = pow(sin(dlat / 2), 2) + cos(lat1) * cos(lat2) * pow(sin(dlon / 2), 2);
+    double c = 2 * asin(sqrt(min(1.0, val)));
+    return R * c;
+}
+
 struct UserPreferences {
     string profileName;
     double timeWeight = 1.0;
@@ -97,6 +136,306 @@ struct GraphStats {
     double maxDistance = 1.0;
 };
 
+// Per-query search counters. Kept on the stack during a search and merged into
+// Instrumentation once at the end, so the inner loop never takes a lock. The
+// increments vanish when MAPS_STATS is 0.
+struct SearchCounters {
+    uint64_t nodesExpanded = 0;
+    uint64_t edgesRelaxed = 0;
+    uint64_t heapPushes = 0;
+    uint64_t stalePops = 0;
+
+    void expanded() { if constexpr (MAPS_STATS != 0) ++nodesExpanded; }
+    void relaxed() { if constexpr (MAPS_STATS != 0) ++edgesRelaxed; }
+    void pushed() { if constexpr (MAPS_STATS != 0) ++heapPushes; }
+    void stale() { if constexpr (MAPS_STATS != 0) ++stalePops; }
+
+    SearchCounters& operator+=(const SearchCounters& o) {
+        nodesExpanded += o.nodesExpanded;
+        edgesRelaxed += o.edgesRelaxed;
+        heapPushes += o.heapPushes;
+        stalePops += o.stalePops;
+        return *this;
+    }
+};
+
+// Optional per-query record of the A* frontier, saved as CSV for plotting.
+// Compiled out together with the counters when MAPS_STATS is 0.
+struct SearchTrace {
+    enum class Event { PUSH, EXPAND, STALE };
+    struct Entry {
+        size_t step;
+        Event event;
+        int id;
+        double g;
+        double f;
+    };
+    int startId = 0;
+    int goalId = 0;
+    vector<Entry> entries;
+};
+
+enum class Phase { LOAD_LOCATIONS, LOAD_ROUTES, SEARCH, RECONSTRUCT, FORMAT, SAVE, OVERLAY_PARTITION, OVERLAY_CUSTOMIZE, COUNT };
+
+string phaseToString(Phase p) {
+    switch (p) {
+        case Phase::LOAD_LOCATIONS: return "load_locations";
+        case Phase::LOAD_ROUTES: return "load_routes";
+        case Phase::SEARCH: return "search";
+        case Phase::RECONSTRUCT: return "reconstruct";
+        case Phase::FORMAT: return "format";
+        case Phase::SAVE: return "save";
+        case Phase::OVERLAY_PARTITION: return "overlay_partition";
+        case Phase::OVERLAY_CUSTOMIZE: return "overlay_customize";
+        case Phase::COUNT: break;
+    }
+    return "unknown";
+}
+
+// Process-wide counters and phase timers. Collection can be switched off at
+// run time (setEnabled) or at compile time (MAPS_STATS=0).
+class Instrumentation {
+private:
+    static constexpr size_t PHASES = static_cast<size_t>(Phase::COUNT);
+
+    mutable mutex mtx;
+    atomic<bool> enabled{MAPS_STATS != 0};
+    uint64_t queries = 0;
+    uint64_t pathsFound = 0;
+    uint64_t pathEdges = 0;
+    SearchCounters search;
+    uint64_t locationRows = 0;
+    uint64_t routeRows = 0;
+    array<double, PHASES> phaseUs{};
+    array<uint64_t, PHASES> phaseCalls{};
+
+    Instrumentation() = default;
+
+public:
+    static Instrumentation& instance() {
+        static Instrumentation inst;
+        return inst;
+    }
+
+    bool isEnabled() const { return MAPS_STATS != 0 && enabled.load(memory_order_relaxed); }
+    void setEnabled(bool on) { enabled.store(on && MAPS_STATS != 0, memory_order_relaxed); }
+
+    // reached is false only when no path exists; start == goal is reached with an empty path
+    void recordQuery(const SearchCounters& c, bool reached, size_t pathLength) {
+        recordQueries(c, 1, reached ? 1 : 0, pathLength);
+    }
+
+    // Merges the totals of a whole batch under a single lock
+    void recordQueries(const SearchCounters& c, uint64_t count, uint64_t found, uint64_t edges) {
+        if (!isEnabled()) return;
+        lock_guard<mutex> lock(mtx);
+        queries += count;
+        pathsFound += found;
+        pathEdges += edges;
+        search += c;
+    }
+
+    void recordRows(Phase p, uint64_t rows) {
+        if (!isEnabled()) return;
+        lock_guard<mutex> lock(mtx);
+        (p == Phase::LOAD_LOCATIONS ? locationRows : routeRows) += rows;
+    }
+
+    void recordPhase(Phase p, double us) {
+        if (!isEnabled()) return;
+        lock_guard<mutex> lock(mtx);
+        phaseUs[static_cast<size_t>(p)] += us;
+        ++phaseCalls[static_cast<size_t>(p)];
+    }
+
+    void reset() {
+        lock_guard<mutex> lock(mtx);
+        queries = pathsFound = pathEdges = locationRows = routeRows = 0;
+        search = {};
+        phaseUs.fill(0);
+        phaseCalls.fill(0);
+    }
+
+    void report(ostream& out) const {
+        lock_guard<mutex> lock(mtx);
+        ios_base::fmtflags savedFlags = out.flags(); // the table below switches alignment
+        streamsize savedPrecision = out.precision();
+        auto perQuery = [this](uint64_t v) { return queries ? double(v) / queries : 0.0; };
+        auto rate = [this](uint64_t rows, Phase p) {
+            double us = phaseUs[static_cast<size_t>(p)];
+            return us > 0 ? rows / (us / 1e6) : 0.0;
+        };
+        out << "collection:        " << (!MAPS_STATS ? "compiled out" : enabled ? "on" : "off") << "\n";
+        out << "queries:           " << queries << " (" << pathsFound << " with a path)\n";
+        out << "nodes_expanded:    " << search.nodesExpanded << " (" << perQuery(search.nodesExpanded) << "/query)\n";
+        out << "edges_relaxed:     " << search.edgesRelaxed << " (" << perQuery(search.edgesRelaxed) << "/query)\n";
+        out << "heap_pushes:       " << search.heapPushes << " (" << perQuery(search.heapPushes) << "/query)\n";
+        out << "stale_pops:        " << search.stalePops << " (" << perQuery(search.stalePops) << "/query)\n";
+        out << "path_edges:        " << pathEdges << " (" << (pathsFound ? double(pathEdges) / pathsFound : 0.0) << "/path)\n";
+        out << "location_rows:     " << locationRows << " (" << rate(locationRows, Phase::LOAD_LOCATIONS) << " rows/s)\n";
+        out << "route_rows:        " << routeRows << " (" << rate(routeRows, Phase::LOAD_ROUTES) << " rows/s)\n";
+        out << "phase wall time (total ms / calls):\n";
+        for (size_t i = 0; i < PHASES; ++i) {
+            out << "  " << left << setw(19) << phaseToString(static_cast<Phase>(i)) << right
+                << phaseUs[i] / 1000.0 << " / " << phaseCalls[i] << "\n";
+        }
+        out.flags(savedFlags);
+        out.precision(savedPrecision);
+    }
+};
+
+// Adds the wall time of its scope (or until stop()) to one phase. Does not even
+// read the clock while collection is off.
+class PhaseTimer {
+private:
+    Phase phase;
+    bool active;
+    chrono::steady_clock::time_point start;
+public:
+    // on = false makes the timer a no-op, for callers that time a whole batch instead
+    explicit PhaseTimer(Phase p, bool on = true) : phase(p), active(on && Instrumentation::instance().isEnabled()) {
+        if (active) start = chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        stop();
+    }
+    void stop() {
+        if (!active) return;
+        active = false;
+        Instrumentation::instance().recordPhase(phase, chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+};
+
+// Work-stealing scheduler shared by loading, overlay customization and batch
+// queries. Every worker owns a deque: it pops its own tasks LIFO and steals
+// from the others FIFO. The thread calling parallelFor runs tasks too until its
+// batch is done, so a pool of concurrency N starts N - 1 background threads and
+// nested parallelFor calls from inside a task cannot deadlock.
+class WorkStealingPool {
+private:
+    using Task = function<void()>;
+    struct Queue {
+        mutex m;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Queue>> queues; // queues[0] is fed by threads outside the pool
+    vector<thread> workers;
+    mutex sleepMtx;
+    condition_variable sleepCv;
+    atomic<size_t> queued{0};
+    bool stopping = false; // guarded by sleepMtx
+
+    static inline thread_local const WorkStealingPool* currentPool = nullptr;
+    static inline thread_local size_t currentQueue = 0;
+
+    size_t homeQueue() const { return currentPool == this ? currentQueue : 0; }
+
+    void push(Task t) {
+        Queue& q = *queues[homeQueue()];
+        {
+            lock_guard<mutex> lock(q.m);
+            q.tasks.push_back(move(t));
+        }
+        queued.fetch_add(1);
+        { lock_guard<mutex> lock(sleepMtx); } // no lost wake-up against the sleep predicate
+        sleepCv.notify_one();
+    }
+
+    bool tryRunOne() {
+        size_t home = homeQueue();
+        Task t;
+        {
+            Queue& q = *queues[home];
+            lock_guard<mutex> lock(q.m);
+            if (!q.tasks.empty()) {
+                t = move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+        }
+        for (size_t k = 1; !t && k < queues.size(); ++k) {
+            Queue& victim = *queues[(home + k) % queues.size()];
+            lock_guard<mutex> lock(victim.m);
+            if (!victim.tasks.empty()) {
+                t = move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!t) return false;
+        queued.fetch_sub(1);
+        t();
+        return true;
+    }
+
+    void workerLoop(size_t index) {
+        currentPool = this;
+        currentQueue = index;
+        while (true) {
+            if (tryRunOne()) continue;
+            unique_lock<mutex> lock(sleepMtx);
+            sleepCv.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t concurrency = thread::hardware_concurrency()) {
+        concurrency = max<size_t>(1, concurrency);
+        for (size_t i = 0; i < concurrency; ++i) queues.push_back(make_unique<Queue>());
+        for (size_t i = 1; i < concurrency; ++i) workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lock(sleepMtx);
+            stopping = true;
+        }
+        sleepCv.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    // Process-wide pool sized to the machine
+    static WorkStealingPool& shared() {
+        static WorkStealingPool pool;
+        return pool;
+    }
+
+    size_t concurrency() const { return queues.size(); }
+
+    // Runs body(i) for i in [0, n) in chunks of `grain`, returning when all are done.
+    // The first exception thrown by any chunk is rethrown here.
+    template <typename F>
+    void parallelFor(size_t n, F&& body, size_t grain = 1) {
+        if (n == 0) return;
+        grain = max<size_t>(1, grain);
+        size_t chunks = (n + grain - 1) / grain;
+        if (queues.size() == 1 || chunks == 1) {
+            for (size_t i = 0; i < n; ++i) body(i);
+            return;
+        }
+        atomic<size_t> remaining{chunks};
+        exception_ptr error;
+        mutex errorMtx;
+        for (size_t c = 0; c < chunks; ++c) {
+            push([&, c] {
+                try {
+                    for (size_t i = c * grain; i < min(n, (c + 1) * grain); ++i) body(i);
+                } catch (...) {
+                    lock_guard<mutex> lock(errorMtx);
+                    if (!error) error = current_exception();
+                }
+                remaining.fetch_sub(1, memory_order_acq_rel);
+            });
+        }
+        while (remaining.load(memory_order_acquire) > 0) {
+            if (!tryRunOne()) this_thread::yield();
+        }
+        if (error) rethrow_exception(error);
+    }
+};
+
 // =================================================================================
 // 2. DECISION TREE IMPLEMENTATION
 // =================================================================================
@@ -123,6 +462,15 @@ private:
         root->children["3. Balanced"] = make_shared<TreeNode>(balanced);
     }
 
+    void collectLeaves(const shared_ptr<TreeNode>& n, vector<UserPreferences>& out) const {
+        if (!n) return;
+        if (n->isLeaf) {
+            out.push_back(n->preferences);
+            return;
+        }
+        for (const auto& p : n->children) collectLeaves(p.second, out);
+    }
+
     void printTree(const shared_ptr<TreeNode>& n, int i) const {
         if (!n) return;
         for (int k = 0; k < i; ++k) cout << "  ";
@@ -202,6 +550,13 @@ public:
         return finalPrefs;
     }
 
+    // Every leaf profile, without asking the user anything
+    vector<UserPreferences> getProfiles() const {
+        vector<UserPreferences> out;
+        collectLeaves(root, out);
+        return out;
+    }
+
     void visualize() const {
         cout << "\n--- Decision Tree ---\n";
         printTree(root, 0);
@@ -212,19 +567,193 @@ public:
 // =================================================================================
 // 3. GRAPH & ROUTING IMPLEMENTATION
 // =================================================================================
+// Append-only arena holding every distinct location name once, packed into
+// fixed-size blocks. Blocks are never moved or freed, so a returned view stays
+// valid for the life of the program. intern() is serialised by a mutex; reading
+// through a view needs no lock.
+class NameTable {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    mutable mutex mtx;
+    vector<unique_ptr<char[]>> blocks;
+    size_t blockUsed = 0;
+    size_t totalBytes = 0;
+    unordered_set<string_view> index; // keys view into the blocks
+
+    NameTable() = default;
+
+    string_view store(string_view s) {
+        if (blocks.empty() || blockUsed + s.size() > BLOCK_SIZE) {
+            // An oversized name gets a block of its own, which is then full
+            blocks.push_back(make_unique<char[]>(max(BLOCK_SIZE, s.size())));
+            blockUsed = 0;
+        }
+        char* dst = blocks.back().get() + blockUsed;
+        copy(s.begin(), s.end(), dst);
+        blockUsed += s.size();
+        return string_view(dst, s.size());
+    }
+
+public:
+    static NameTable& instance() {
+        static NameTable inst;
+        return inst;
+    }
+
+    string_view intern(string_view s) {
+        lock_guard<mutex> lock(mtx);
+        auto it = index.find(s);
+        if (it != index.end()) return *it;
+        string_view stored = store(s);
+        totalBytes += s.size();
+        index.insert(stored);
+        return stored;
+    }
+
+    size_t size() const { lock_guard<mutex> lock(mtx); return index.size(); }
+    size_t bytes() const { lock_guard<mutex> lock(mtx); return totalBytes; }
+};
+
 class Location {
 private:
     int id;
-    string name;
+    string_view name; // interned, see NameTable
     double latitude;
     double longitude;
 public:
-    Location(int id = 0, string nm = "N/A", double lat = 0, double lon = 0) : id(id), name(nm), latitude(lat), longitude(lon) {}
+    Location(int id = 0, string_view nm = "N/A", double lat = 0, double lon = 0) : id(id), name(NameTable::instance().intern(nm)), latitude(lat), longitude(lon) {}
     int getId() const { return id; }
-    string getName() const { return name; }
+    string_view getName() const { return name; }
     double getLatitude() const { return latitude; }
     double getLongitude() const { return longitude; }
-    void update(string nm, double lat, double lon) { name = nm; latitude = lat; longitude = lon; }
+    void update(string_view nm, double lat, double lon) { name = NameTable::instance().intern(nm); latitude = lat; longitude = lon; }
+};
+
+// Uniform lat/lon cell grid over location coordinates. Answers "k nearest" and
+// "within radius" queries without scanning every location. The grid does not
+// wrap at the antimeridian, which is fine for a national-scope network.
+class SpatialIndex {
+private:
+    using Cell = pair<int, int>; // (row = latitude band, col = longitude band)
+
+    double cellSize; // in degrees
+    map<Cell, vector<int>> cells;
+    map<int, pair<double, double>> positions; // id -> (lat, lon)
+    int minRow = 0, maxRow = -1, minCol = 0, maxCol = -1;
+
+    // Coordinates are clamped first so the int casts can never overflow
+    Cell cellFor(double lat, double lon) const {
+        lat = isnan(lat) ? 0.0 : clamp(lat, -90.0, 90.0);
+        lon = isnan(lon) ? 0.0 : clamp(lon, -360.0, 360.0);
+        return {static_cast<int>(floor(lat / cellSize)), static_cast<int>(floor(lon / cellSize))};
+    }
+
+    // Lower bound (km) on the distance from (lat, lon) to any point lying in a
+    // cell more than `ring` cells away from the query's own cell.
+    double ringLowerBoundKm(double lat, int ring) const {
+        const double R = 6371;
+        double spanDeg = ring * cellSize;
+        double byLat = R * spanDeg * M_PI / 180.0;
+        double farLat = min(90.0, fabs(lat) + spanDeg) * M_PI / 180.0;
+        double cosProduct = max(0.0, cos(lat * M_PI / 180.0) * cos(farLat));
+        double halfLon = min(180.0, spanDeg) * M_PI / 360.0;
+        double byLon = 2 * R * asin(min(1.0, sqrt(cosProduct) * sin(halfLon)));
+        return min(byLat, byLon);
+    }
+
+    void collectCell(const Cell& c, double lat, double lon, vector<pair<double, int>>& out) const {
+        auto it = cells.find(c);
+        if (it == cells.end()) return;
+        for (int id : it->second) {
+            const auto& pos = positions.at(id);
+            out.push_back({haversineKm(lat, lon, pos.first, pos.second), id});
+        }
+    }
+
+public:
+    explicit SpatialIndex(double cellSizeDeg = 0.5) : cellSize(clamp(cellSizeDeg, 1e-3, 90.0)) {}
+
+    bool empty() const { return positions.empty(); }
+
+    void insert(int id, double lat, double lon) {
+        if (positions.count(id)) remove(id);
+        Cell c = cellFor(lat, lon);
+        cells[c].push_back(id);
+        positions[id] = {lat, lon};
+        if (minRow > maxRow) {
+            minRow = maxRow = c.first;
+            minCol = maxCol = c.second;
+        } else {
+            minRow = min(minRow, c.first); maxRow = max(maxRow, c.first);
+            minCol = min(minCol, c.second); maxCol = max(maxCol, c.second);
+        }
+    }
+
+    void remove(int id) {
+        auto pos = positions.find(id);
+        if (pos == positions.end()) return;
+        Cell c = cellFor(pos->second.first, pos->second.second);
+        auto& bucket = cells.at(c);
+        bucket.erase(std::remove(bucket.begin(), bucket.end(), id), bucket.end());
+        if (bucket.empty()) cells.erase(c);
+        positions.erase(pos);
+    }
+
+    // Up to k (distanceKm, id) pairs, closest first.
+    vector<pair<double, int>> kNearest(double lat, double lon, size_t k) const {
+        vector<pair<double, int>> found;
+        if (k == 0 || positions.empty()) return found;
+        Cell q = cellFor(lat, lon);
+        int maxRing = max({abs(q.first - minRow), abs(q.first - maxRow), abs(q.second - minCol), abs(q.second - maxCol)});
+        for (int ring = 0; ring <= maxRing; ++ring) {
+            for (int r = q.first - ring; r <= q.first + ring; ++r) {
+                if (r < minRow || r > maxRow) continue;
+                for (int c = q.second - ring; c <= q.second + ring; ++c) {
+                    if (c < minCol || c > maxCol) continue;
+                    bool onRing = abs(r - q.first) == ring || abs(c - q.second) == ring;
+                    if (onRing) collectCell({r, c}, lat, lon, found);
+                }
+            }
+            if (found.size() >= k) {
+                nth_element(found.begin(), found.begin() + (k - 1), found.end());
+                if (found[k - 1].first <= ringLowerBoundKm(lat, ring)) break;
+            }
+        }
+        sort(found.begin(), found.end());
+        if (found.size() > k) found.resize(k);
+        return found;
+    }
+
+    // Every (distanceKm, id) pair within radiusKm, closest first.
+    vector<pair<double, int>> withinRadius(double lat, double lon, double radiusKm) const {
+        vector<pair<double, int>> found;
+        if (!(radiusKm >= 0) || positions.empty()) return found;
+        double dLat = min(180.0, radiusKm / 6371 * 180.0 / M_PI);
+        double farLat = min(90.0, fabs(lat) + dLat);
+        double dLon = farLat >= 90.0 ? 180.0 : min(180.0, dLat / cos(farLat * M_PI / 180.0));
+        Cell lo = cellFor(lat - dLat, lon - dLon);
+        Cell hi = cellFor(lat + dLat, lon + dLon);
+        lo = {max(lo.first, minRow), max(lo.second, minCol)};
+        hi = {min(hi.first, maxRow), min(hi.second, maxCol)};
+        if (lo.first > hi.first || lo.second > hi.second) return found;
+        double span = double(hi.first - lo.first + 1) * (hi.second - lo.second + 1);
+        if (span <= cells.size()) {
+            for (int r = lo.first; r <= hi.first; ++r) {
+                for (int c = lo.second; c <= hi.second; ++c) collectCell({r, c}, lat, lon, found);
+            }
+        } else {
+            for (const auto& [c, ids] : cells) {
+                if (c.first < lo.first || c.first > hi.first || c.second < lo.second || c.second > hi.second) continue;
+                collectCell(c, lat, lon, found);
+            }
+        }
+        found.erase(remove_if(found.begin(), found.end(), [radiusKm](const pair<double, int>& e) {
+            return e.first > radiusKm;
+        }), found.end());
+        sort(found.begin(), found.end());
+        return found;
+    }
 };
 
 class Route {
@@ -262,31 +791,56 @@ public:
     }
 };
 
+// Merges the per-query counters of a batch into Instrumentation under one lock
+void recordBatch(const vector<SearchCounters>& counters, const vector<char>& reached, const vector<vector<shared_ptr<const Route>>>& paths) {
+    if (!Instrumentation::instance().isEnabled()) return;
+    SearchCounters total;
+    uint64_t found = 0, edges = 0;
+    for (size_t i = 0; i < counters.size(); ++i) {
+        total += counters[i];
+        if (reached[i]) ++found;
+        edges += paths[i].size();
+    }
+    Instrumentation::instance().recordQueries(total, counters.size(), found, edges);
+}
+
 class Graph {
 private:
     map<int, Location> locations;
     map<int, vector<shared_ptr<Route>>> adjList;
+    SpatialIndex spatialIndex;
     GraphStats stats;
     int nextId = 1;
+    uint64_t version = 0; // bumped on every mutation so derived structures can tell they are stale
+
+    // Versions come from one process-wide counter, so (graph address, version)
+    // never repeats even when a new Graph reuses a destroyed one's storage
+    void bumpVersion() {
+        static atomic<uint64_t> source{0};
+        version = ++source;
+    }
+
+    // Scratch state for search(), one per thread. The dense index is rebuilt only
+    // when the graph changes; the buffers are reused across queries.
+    struct SearchContext {
+        const Graph* graph = nullptr;
+        uint64_t version = 0;
+        unordered_map<int, int> denseOf; // location ID -> dense index, ascending with the ID
+        vector<int> denseToId;
+        vector<double> g;
+        vector<int> parent; // dense index of the predecessor, -1 at the start
+        vector<tuple<double, int, double>> heap; // (f, dense index, g at push time)
+    };
 
     double heuristic(const Location& a, const Location& b) const {
-        const double R = 6371;
-        double lat1 = a.getLatitude() * M_PI / 180.0;
-        double lon1 = a.getLongitude() * M_PI / 180.0;
-        double lat2 = b.getLatitude() * M_PI / 180.0;
-        double lon2 = b.getLongitude() * M_PI / 180.0;
-        double dlon = lon2 - lon1;
-        double dlat = lat2 - lat1;
-        double val = pow(sin(dlat / 2), 2) + cos(lat1) * cos(lat2) * pow(sin(dlon / 2), 2);
-        double c = 2 * asin(sqrt(val));
-        return R * c;
-    }
-
-    vector<shared_ptr<const Route>> reconstructPath(const map<int, int>& came_from, int currentId) const {
+        return haversineKm(a.getLatitude(), a.getLongitude(), b.getLatitude(), b.getLongitude());
+    }
+
+    vector<shared_ptr<const Route>> reconstructPath(const SearchContext& ctx, int current) const {
         vector<shared_ptr<const Route>> path;
-        int toId = currentId;
-        while (came_from.count(toId)) {
-            int fromId = came_from.at(toId);
+        for (; ctx.parent[current] >= 0; current = ctx.parent[current]) {
+            int fromId = ctx.denseToId[ctx.parent[current]];
+            int toId = ctx.denseToId[current];
             shared_ptr<const Route> routeTaken = nullptr;
             for (const auto& r : adjList.at(fromId)) {
                 if (r->getDestination()->getId() == toId) {
@@ -297,7 +851,6 @@ private:
             if (routeTaken) {
                 path.push_back(routeTaken);
             }
-            toId = fromId;
         }
         reverse(path.begin(), path.end());
         return path;
@@ -308,11 +861,15 @@ public:
 
     const map<int, Location>& getAllLocations() const { return locations; }
     const map<int, vector<shared_ptr<Route>>>& getAdjList() const { return adjList; }
+    const GraphStats& getStats() const { return stats; }
+    uint64_t getVersion() const { return version; }
 
     int addLocation(const string& n, double la, double lo) {
         int i = nextId++;
+        bumpVersion();
         locations[i] = Location(i, n, la, lo);
         adjList[i] = {};
+        spatialIndex.insert(i, la, lo);
         return i;
     }
 
@@ -322,6 +879,7 @@ public:
             throw runtime_error("Route must have a specific type.");
         }
         adjList.at(s).push_back(make_shared<ConcreteRoute>(&locations.at(s), &locations.at(d), di, ti, co, ty));
+        bumpVersion();
         if (ti > stats.maxTime) stats.maxTime = ti;
         if (co > stats.maxCost) stats.maxCost = co;
         if (di > stats.maxDistance) stats.maxDistance = di;
@@ -330,6 +888,8 @@ public:
     bool updateLocation(int i, const string& n, double la, double lo) {
         if (!locations.count(i)) return false;
         locations.at(i).update(n, la, lo);
+        spatialIndex.insert(i, la, lo);
+        bumpVersion();
         return true;
     }
 
@@ -340,6 +900,7 @@ public:
         rs.erase(remove_if(rs.begin(), rs.end(), [d](const shared_ptr<Route>& r) {
             return r->getDestination()->getId() == d;
         }), rs.end());
+        if (rs.size() < oS) bumpVersion();
         return rs.size() < oS;
     }
 
@@ -347,6 +908,8 @@ public:
         if (!locations.count(i)) return false;
         locations.erase(i);
         adjList.erase(i);
+        spatialIndex.remove(i);
+        bumpVersion();
         for (auto& p : adjList) {
             auto& rs = p.second;
             rs.erase(remove_if(rs.begin(), rs.end(), [i](const shared_ptr<Route>& r) {
@@ -382,8 +945,9 @@ public:
                 routesExist = true;
                 cout << "FROM: " << pair.first << " (" << locations.at(pair.first).getName() << ")" << endl;
                 for (const auto& r : pair.second) {
+                    string_view dn = r->getDestination()->getName();
                     cout << "  -> TO: " << left << setw(4) << r->getDestination()->getId()
-                         << left << setw(15) << ("(" + r->getDestination()->getName() + ")")
+                         << "(" << dn << ")" << setw(max(0, 13 - static_cast<int>(dn.size()))) << ""
                          << " | BY: " << left << setw(7) << transportTypeToString(r->getType())
                          << " | Time: " << r->getTime() << "m"
                          << " | Cost: " << r->getCost() << "k"
@@ -403,97 +967,737 @@ public:
         return locations.count(i);
     }
 
-    vector<shared_ptr<const Route>> findShortestPath(int sI, int gI, const UserPreferences& pr) const {
-        using QE = pair<double, int>;
-        priority_queue<QE, vector<QE>, greater<QE>> o;
-        map<int, int> cf;
-        map<int, double> gs;
-        for (const auto& p : locations) {
-            gs[p.first] = numeric_limits<double>::infinity();
-        }
-        gs[sI] = 0;
-        o.push({heuristic(locations.at(sI), locations.at(gI)), sI});
-        cout << "\nSearching...\n";
+    vector<pair<double, int>> findNearestLocations(double la, double lo, size_t k) const {
+        return spatialIndex.kNearest(la, lo, k);
+    }
+
+    vector<pair<double, int>> findLocationsWithinRadius(double la, double lo, double radiusKm) const {
+        return spatialIndex.withinRadius(la, lo, radiusKm);
+    }
+
+    // Snaps raw coordinates to the nearest stop; returns 0 when no locations exist.
+    int snapToNearestLocation(double la, double lo) const {
+        auto nearest = spatialIndex.kNearest(la, lo, 1);
+        return nearest.empty() ? 0 : nearest.front().second;
+    }
+
+private:
+    // A* without console output. Counters go to sc and are recorded by the caller;
+    // the scratch buffers are per thread, so concurrent searches never contend.
+    // timed = false skips the per-query phase timers (batches time themselves).
+    // reached tells "no path" apart from start == goal, which also yields an empty path.
+    vector<shared_ptr<const Route>> search(int sI, int gI, const UserPreferences& pr, SearchTrace* trace, SearchCounters& sc, bool timed, bool& reached) const {
+        reached = false;
+        static thread_local SearchContext ctx;
+        size_t step = 0;
+        auto record = [&](SearchTrace::Event e, int id, double g, double f) {
+            if constexpr (MAPS_STATS != 0) {
+                if (trace) trace->entries.push_back({step, e, id, g, f});
+            }
+        };
+        if (trace) {
+            trace->startId = sI;
+            trace->goalId = gI;
+            trace->entries.clear();
+        }
+        PhaseTimer timer(Phase::SEARCH, timed);
+        if (ctx.graph != this || ctx.version != version) {
+            ctx.graph = this;
+            ctx.version = version;
+            ctx.denseOf.clear();
+            ctx.denseToId.clear();
+            for (const auto& p : locations) {
+                ctx.denseOf.emplace(p.first, static_cast<int>(ctx.denseToId.size()));
+                ctx.denseToId.push_back(p.first);
+            }
+        }
+        auto& gs = ctx.g;
+        auto& o = ctx.heap;
+        gs.assign(ctx.denseToId.size(), numeric_limits<double>::infinity());
+        ctx.parent.assign(ctx.denseToId.size(), -1);
+        o.clear();
+        // Dense indices ascend with IDs, so ties pop in the same order as by ID
+        auto cmp = greater<tuple<double, int, double>>();
+        int s = ctx.denseOf.at(sI), goal = ctx.denseOf.at(gI);
+        const Location& goalLoc = locations.at(gI);
+        gs[s] = 0;
+        double h0 = heuristic(locations.at(sI), goalLoc);
+        o.push_back({h0, s, 0.0});
+        sc.pushed();
+        record(SearchTrace::Event::PUSH, sI, 0.0, h0);
         while (!o.empty()) {
-            int cI = o.top().second;
-            o.pop();
-            if (cI == gI) {
-                return reconstructPath(cf, cI);
-            }
-            if (adjList.count(cI)) {
-                for (const auto& r : adjList.at(cI)) {
-                    int nI = r->getDestination()->getId();
-                    double tgs = gs.at(cI) + r->calculateWeight(pr, stats);
-                    if (tgs < gs.at(nI)) {
-                        cf[nI] = cI;
-                        gs[nI] = tgs;
-                        double fs = gs.at(nI) + heuristic(locations.at(nI), locations.at(gI));
-                        o.push({fs, nI});
-                    }
+            pop_heap(o.begin(), o.end(), cmp);
+            auto [cF, c, cG] = o.back();
+            o.pop_back();
+            int cI = ctx.denseToId[c];
+            if constexpr (MAPS_STATS != 0) ++step;
+            if (cG > gs[c]) {
+                // Superseded by a cheaper push; re-expanding it could not improve anything
+                sc.stale();
+                record(SearchTrace::Event::STALE, cI, cG, cF);
+                continue;
+            }
+            sc.expanded();
+            record(SearchTrace::Event::EXPAND, cI, cG, cF);
+            if (c == goal) {
+                reached = true;
+                timer.stop();
+                PhaseTimer rt(Phase::RECONSTRUCT, timed);
+                return reconstructPath(ctx, c);
+            }
+            auto adj = adjList.find(cI);
+            if (adj == adjList.end()) continue;
+            for (const auto& r : adj->second) {
+                const Location* dest = r->getDestination();
+                int n = ctx.denseOf.at(dest->getId());
+                double tgs = gs[c] + r->calculateWeight(pr, stats);
+                sc.relaxed();
+                if (tgs < gs[n]) {
+                    ctx.parent[n] = c;
+                    gs[n] = tgs;
+                    double fs = tgs + heuristic(*dest, goalLoc);
+                    o.push_back({fs, n, tgs});
+                    push_heap(o.begin(), o.end(), cmp);
+                    sc.pushed();
+                    record(SearchTrace::Event::PUSH, dest->getId(), tgs, fs);
                 }
             }
         }
-        cout << Color::RED << "No path found from " << locations.at(sI).getName() << " to " << locations.at(gI).getName() << Color::RESET << ".\n";
         return {};
     }
+
+public:
+    // trace, when given, receives every push/expand/stale-pop of the search
+    vector<shared_ptr<const Route>> findShortestPath(int sI, int gI, const UserPreferences& pr, SearchTrace* trace = nullptr) const {
+        cout << "\nSearching...\n";
+        SearchCounters sc;
+        bool reached = false;
+        vector<shared_ptr<const Route>> path = search(sI, gI, pr, trace, sc, true, reached);
+        Instrumentation::instance().recordQuery(sc, reached, path.size());
+        if (!reached) {
+            cout << Color::RED << "No path found from " << locations.at(sI).getName() << " to " << locations.at(gI).getName() << Color::RESET << ".\n";
+        }
+        return path;
+    }
+
+    // Answers many OD pairs at once on the pool; result i belongs to od[i].
+    // Unknown IDs yield an empty path. The graph must not be modified meanwhile.
+    // The SEARCH phase gets the wall time of the whole batch, and the counters are
+    // kept per query and merged once at the end.
+    vector<vector<shared_ptr<const Route>>> findShortestPaths(const vector<pair<int, int>>& od, const UserPreferences& pr,
+                                                              WorkStealingPool& pool = WorkStealingPool::shared()) const {
+        PhaseTimer timer(Phase::SEARCH);
+        vector<vector<shared_ptr<const Route>>> out(od.size());
+        vector<SearchCounters> counters(od.size());
+        vector<char> reached(od.size(), 0);
+        pool.parallelFor(od.size(), [&](size_t i) {
+            if (!isValidLocation(od[i].first) || !isValidLocation(od[i].second)) return;
+            bool r = false;
+            out[i] = search(od[i].first, od[i].second, pr, nullptr, counters[i], false, r);
+            reached[i] = r;
+        });
+        timer.stop();
+        recordBatch(counters, reached, out);
+        return out;
+    }
+
+    vector<shared_ptr<const Route>> findShortestPath(double sLa, double sLo, double gLa, double gLo, const UserPreferences& pr, SearchTrace* trace = nullptr) const {
+        int sI = snapToNearestLocation(sLa, sLo);
+        int gI = snapToNearestLocation(gLa, gLo);
+        if (!sI || !gI) return {};
+        return findShortestPath(sI, gI, pr, trace);
+    }
+};
+
+// Customizable route planning over island cells (CRP / multi-level Dijkstra with
+// one overlay level). Preprocessing is metric-independent: it splits the graph
+// into cells (land-connected islands, bisected geographically while too large)
+// and finds each cell's boundary stops. Customization is per preference profile:
+// it fills each cell's boundary-to-boundary clique matrix and is cached, so a new
+// UserPreferences only pays for the cheap phase. Queries run Dijkstra on the
+// original arcs of the source/target cells and on the overlay everywhere else.
+class OverlayRouter {
+private:
+    static constexpr double INF = numeric_limits<double>::infinity();
+
+    struct Arc {
+        int to; // dense index
+        shared_ptr<const Route> route;
+    };
+    struct Cell {
+        vector<int> nodes;
+        vector<int> boundary;
+    };
+    struct Customization {
+        vector<double> arcWeight;      // parallel to arcs
+        vector<vector<double>> clique; // per cell, |boundary|^2 row-major
+    };
+
+    const Graph& graph;
+    size_t requestedCellSize; // 0 = derive from the graph size on every rebuild
+    size_t maxCellSize = 0;
+    uint64_t builtVersion = numeric_limits<uint64_t>::max();
+
+    vector<int> denseToId;
+    map<int, int> idToDense;
+    vector<size_t> arcStart; // CSR offsets into arcs, size n + 1
+    vector<Arc> arcs;
+    vector<int> cellOf;
+    vector<int> localIndex;    // position of a node inside its cell's node list
+    vector<int> boundaryIndex; // position inside its cell's boundary list, -1 if interior
+    vector<Cell> cells;
+    map<string, Customization> customizations;
+
+    static string profileKey(const UserPreferences& p) {
+        return p.profileName + "|" + to_string(p.timeWeight) + "|" + to_string(p.costWeight) + "|" +
+               to_string(p.distanceWeight) + "|" + transportTypeToString(p.preferredTransport);
+    }
+
+    void splitCell(vector<int>& nodes, const vector<pair<double, double>>& coords) {
+        if (nodes.size() <= max<size_t>(1, maxCellSize)) {
+            int c = static_cast<int>(cells.size());
+            cells.push_back({nodes, {}});
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                cellOf[nodes[i]] = c;
+                localIndex[nodes[i]] = static_cast<int>(i);
+            }
+            return;
+        }
+        // Cut across the wider extent at the median stop
+        double minLa = INF, maxLa = -INF, minLo = INF, maxLo = -INF;
+        for (int u : nodes) {
+            minLa = min(minLa, coords[u].first); maxLa = max(maxLa, coords[u].first);
+            minLo = min(minLo, coords[u].second); maxLo = max(maxLo, coords[u].second);
+        }
+        double lonScale = cos((minLa + maxLa) / 2 * M_PI / 180.0);
+        bool byLat = (maxLa - minLa) >= (maxLo - minLo) * lonScale;
+        auto mid = nodes.begin() + nodes.size() / 2;
+        nth_element(nodes.begin(), mid, nodes.end(), [&](int a, int b) {
+            return byLat ? coords[a].first < coords[b].first : coords[a].second < coords[b].second;
+        });
+        vector<int> lo(nodes.begin(), mid), hi(mid, nodes.end());
+        splitCell(lo, coords);
+        splitCell(hi, coords);
+    }
+
+    void preprocess() {
+        PhaseTimer timer(Phase::OVERLAY_PARTITION);
+        denseToId.clear(); idToDense.clear(); arcStart.clear(); arcs.clear();
+        cells.clear(); customizations.clear();
+        // Roughly sqrt(|V|) stops per cell unless the caller fixed the size; the graph may have grown since the last build
+        maxCellSize = requestedCellSize ? requestedCellSize : max<size_t>(8, static_cast<size_t>(sqrt(double(graph.getAllLocations().size()))));
+
+        for (const auto& [id, loc] : graph.getAllLocations()) {
+            idToDense[id] = static_cast<int>(denseToId.size());
+            denseToId.push_back(id);
+        }
+        size_t n = denseToId.size();
+        vector<pair<double, double>> coords(n);
+        arcStart.assign(n + 1, 0);
+        for (size_t u = 0; u < n; ++u) {
+            const Location& loc = graph.getAllLocations().at(denseToId[u]);
+            coords[u] = {loc.getLatitude(), loc.getLongitude()};
+            auto it = graph.getAdjList().find(denseToId[u]);
+            if (it != graph.getAdjList().end()) {
+                for (const auto& r : it->second) arcs.push_back({idToDense.at(r->getDestination()->getId()), r});
+            }
+            arcStart[u + 1] = arcs.size();
+        }
+
+        // Islands: stops joined by land transport, found with union-find
+        vector<int> parent(n);
+        iota(parent.begin(), parent.end(), 0);
+        auto find = [&parent](int x) {
+            while (parent[x] != x) x = parent[x] = parent[parent[x]];
+            return x;
+        };
+        for (size_t u = 0; u < n; ++u) {
+            for (size_t a = arcStart[u]; a < arcStart[u + 1]; ++a) {
+                TransportationType t = arcs[a].route->getType();
+                if (t == TransportationType::BUS || t == TransportationType::TRAIN) parent[find(static_cast<int>(u))] = find(arcs[a].to);
+            }
+        }
+        map<int, vector<int>> islands;
+        for (size_t u = 0; u < n; ++u) islands[find(static_cast<int>(u))].push_back(static_cast<int>(u));
+
+        cellOf.assign(n, -1);
+        localIndex.assign(n, -1);
+        for (auto& [root, nodes] : islands) splitCell(nodes, coords);
+
+        // Boundary stops: endpoints of arcs that cross cells
+        boundaryIndex.assign(n, -1);
+        auto markBoundary = [this](int u) {
+            if (boundaryIndex[u] >= 0) return;
+            auto& b = cells[cellOf[u]].boundary;
+            boundaryIndex[u] = static_cast<int>(b.size());
+            b.push_back(u);
+        };
+        for (size_t u = 0; u < n; ++u) {
+            for (size_t a = arcStart[u]; a < arcStart[u + 1]; ++a) {
+                if (cellOf[u] != cellOf[arcs[a].to]) {
+                    markBoundary(static_cast<int>(u));
+                    markBoundary(arcs[a].to);
+                }
+            }
+        }
+        builtVersion = graph.getVersion();
+    }
+
+    // Dijkstra from src that never leaves src's cell. dist/viaArc are indexed by localIndex.
+    void cellDijkstra(int src, const vector<double>& w, vector<double>& dist, vector<size_t>& viaArc) const {
+        const Cell& cell = cells[cellOf[src]];
+        dist.assign(cell.nodes.size(), INF);
+        viaArc.assign(cell.nodes.size(), numeric_limits<size_t>::max());
+        using QE = pair<double, int>;
+        priority_queue<QE, vector<QE>, greater<QE>> pq;
+        dist[localIndex[src]] = 0;
+        pq.push({0, src});
+        while (!pq.empty()) {
+            auto [d, u] = pq.top();
+            pq.pop();
+            if (d > dist[localIndex[u]]) continue;
+            for (size_t a = arcStart[u]; a < arcStart[u + 1]; ++a) {
+                int v = arcs[a].to;
+                if (cellOf[v] != cellOf[src]) continue;
+                double nd = d + w[a];
+                if (nd < dist[localIndex[v]]) {
+                    dist[localIndex[v]] = nd;
+                    viaArc[localIndex[v]] = a;
+                    pq.push({nd, v});
+                }
+            }
+        }
+    }
+
+    // Scratch buffers for one query, kept per thread so batch queries never share or reallocate them
+    struct QueryContext {
+        vector<double> dist;
+        vector<pair<int, size_t>> parent;
+        vector<pair<double, int>> heap;
+        vector<double> cellDist;
+        vector<size_t> cellVia;
+    };
+
+    const Customization& customize(const UserPreferences& pr, WorkStealingPool& pool) {
+        if (builtVersion != graph.getVersion()) preprocess();
+        string key = profileKey(pr);
+        auto it = customizations.find(key);
+        if (it != customizations.end()) return it->second;
+
+        PhaseTimer timer(Phase::OVERLAY_CUSTOMIZE);
+        Customization c;
+        c.arcWeight.resize(arcs.size());
+        pool.parallelFor(arcs.size(), [&](size_t a) {
+            c.arcWeight[a] = arcs[a].route->calculateWeight(pr, graph.getStats());
+        }, 4096);
+        c.clique.resize(cells.size());
+        // Cells are independent: each task fills only its own clique matrix
+        pool.parallelFor(cells.size(), [&](size_t ci) {
+            vector<double> dist;
+            vector<size_t> via;
+            const auto& b = cells[ci].boundary;
+            c.clique[ci].assign(b.size() * b.size(), INF);
+            for (size_t i = 0; i < b.size(); ++i) {
+                cellDijkstra(b[i], c.arcWeight, dist, via);
+                for (size_t j = 0; j < b.size(); ++j) c.clique[ci][i * b.size() + j] = dist[localIndex[b[j]]];
+            }
+        });
+        return customizations.emplace(key, move(c)).first->second;
+    }
+
+    // Read-only on the router, so any number of threads may run it at once.
+    // Counters go to sc; timed = false skips the per-query phase timers.
+    // reached is false only when t is unreachable (s == t gives an empty path too).
+    vector<shared_ptr<const Route>> query(int s, int t, const Customization& c, SearchCounters& sc, bool timed, bool& reached) const {
+        static thread_local QueryContext ctx;
+        PhaseTimer timer(Phase::SEARCH, timed);
+        int cs = cellOf[s], ct = cellOf[t];
+
+        // parent = (previous node, arc index) for original arcs or (previous node, SHORTCUT) for clique shortcuts
+        size_t n = denseToId.size();
+        const size_t SHORTCUT = numeric_limits<size_t>::max();
+        auto& dist = ctx.dist;
+        auto& parent = ctx.parent;
+        auto& heap = ctx.heap;
+        dist.assign(n, INF);
+        parent.assign(n, {-1, SHORTCUT});
+        heap.clear();
+        auto cmp = greater<pair<double, int>>();
+        dist[s] = 0;
+        heap.push_back({0, s});
+        sc.pushed();
+        auto relax = [&](int u, int v, double nd, size_t via) {
+            sc.relaxed();
+            if (nd < dist[v]) {
+                dist[v] = nd;
+                parent[v] = {u, via};
+                heap.push_back({nd, v});
+                push_heap(heap.begin(), heap.end(), cmp);
+                sc.pushed();
+            }
+        };
+        while (!heap.empty()) {
+            pop_heap(heap.begin(), heap.end(), cmp);
+            auto [d, u] = heap.back();
+            heap.pop_back();
+            if (d > dist[u]) { sc.stale(); continue; }
+            sc.expanded();
+            if (u == t) break;
+            int cu = cellOf[u];
+            bool local = cu == cs || cu == ct;
+            if (!local && boundaryIndex[u] >= 0) {
+                const auto& b = cells[cu].boundary;
+                const double* row = &c.clique[cu][boundaryIndex[u] * b.size()];
+                for (size_t j = 0; j < b.size(); ++j) {
+                    if (row[j] < INF && b[j] != u) relax(u, b[j], d + row[j], SHORTCUT);
+                }
+            }
+            for (size_t a = arcStart[u]; a < arcStart[u + 1]; ++a) {
+                int v = arcs[a].to;
+                if (local || cellOf[v] != cu) relax(u, v, d + c.arcWeight[a], a);
+            }
+        }
+        reached = dist[t] < INF;
+        if (!reached) return {};
+
+        // Unpack shortcuts back into original routes
+        timer.stop();
+        PhaseTimer rt(Phase::RECONSTRUCT, timed);
+        vector<shared_ptr<const Route>> path;
+        for (int v = t; v != s;) {
+            auto [u, a] = parent[v];
+            if (a != SHORTCUT) {
+                path.push_back(arcs[a].route);
+            } else {
+                cellDijkstra(u, c.arcWeight, ctx.cellDist, ctx.cellVia);
+                for (int x = v; x != u;) {
+                    size_t ia = ctx.cellVia[localIndex[x]];
+                    path.push_back(arcs[ia].route);
+                    x = idToDense.at(arcs[ia].route->getSource()->getId());
+                }
+            }
+            v = u;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+public:
+    // maxCellStops of 0 picks roughly sqrt(|V|) stops per cell
+    explicit OverlayRouter(const Graph& g, size_t maxCellStops = 0) : graph(g), requestedCellSize(maxCellStops) {}
+
+    size_t getCellCount() {
+        prepare();
+        return cells.size();
+    }
+
+    // Builds the partition now (it is otherwise built lazily by the first query).
+    void prepare() {
+        if (builtVersion != graph.getVersion()) preprocess();
+    }
+
+    // Runs (or reuses) the customization for a profile without answering a query.
+    void prepareProfile(const UserPreferences& pr, WorkStealingPool& pool = WorkStealingPool::shared()) {
+        prepare();
+        customize(pr, pool);
+    }
+
+    vector<shared_ptr<const Route>> findShortestPath(int sI, int gI, const UserPreferences& pr) {
+        prepare();
+        if (!idToDense.count(sI) || !idToDense.count(gI)) return {};
+        SearchCounters sc;
+        bool reached = false;
+        vector<shared_ptr<const Route>> path = query(idToDense.at(sI), idToDense.at(gI), customize(pr, WorkStealingPool::shared()), sc, true, reached);
+        Instrumentation::instance().recordQuery(sc, reached, path.size());
+        if (!reached) {
+            cout << Color::RED << "No path found from " << graph.getAllLocations().at(sI).getName() << " to " << graph.getAllLocations().at(gI).getName() << Color::RESET << ".\n";
+        }
+        return path;
+    }
+
+    // Batch version of findShortestPath on the pool; result i belongs to od[i].
+    // Like Graph::findShortestPaths, it records counters and SEARCH time once per batch.
+    vector<vector<shared_ptr<const Route>>> findShortestPaths(const vector<pair<int, int>>& od, const UserPreferences& pr,
+                                                              WorkStealingPool& pool = WorkStealingPool::shared()) {
+        prepare();
+        const Customization& c = customize(pr, pool);
+        PhaseTimer timer(Phase::SEARCH);
+        vector<vector<shared_ptr<const Route>>> out(od.size());
+        vector<SearchCounters> counters(od.size());
+        vector<char> reached(od.size(), 0);
+        pool.parallelFor(od.size(), [&](size_t i) {
+            auto s = idToDense.find(od[i].first), t = idToDense.find(od[i].second);
+            if (s == idToDense.end() || t == idToDense.end()) return;
+            bool r = false;
+            out[i] = query(s->second, t->second, c, counters[i], false, r);
+            reached[i] = r;
+        });
+        timer.stop();
+        recordBatch(counters, reached, out);
+        return out;
+    }
 };
 
 // =================================================================================
 // 4. FILE MANAGER CLASS
 // =================================================================================
+enum class OutputFormat { CONSOLE_TXT, FILE_TXT, CSV };
+
+// Growable character buffer that is cleared and reused between formatting calls.
+// Numbers go through to_chars, so there is no stream or locale overhead.
+class OutputBuffer {
+private:
+    string data;
+public:
+    explicit OutputBuffer(size_t reserveBytes = 4096) { data.reserve(reserveBytes); }
+    void clear() { data.clear(); }
+    string_view view() const { return data; }
+
+    OutputBuffer& operator<<(string_view v) { data.append(v); return *this; }
+    OutputBuffer& operator<<(char c) { data.push_back(c); return *this; }
+
+    template <typename T, enable_if_t<is_integral_v<T>, int> = 0>
+    OutputBuffer& operator<<(T v) {
+        char tmp[24];
+        auto res = to_chars(tmp, tmp + sizeof(tmp), v);
+        data.append(tmp, res.ptr);
+        return *this;
+    }
+
+    // Same rendering as the default ostream format (%g, 6 significant digits)
+    OutputBuffer& operator<<(double v) {
+        char tmp[32];
+        auto res = to_chars(tmp, tmp + sizeof(tmp), v, chars_format::general, 6);
+        data.append(tmp, res.ptr);
+        return *this;
+    }
+
+    OutputBuffer& appendFixed(double v, int precision) {
+        char tmp[352]; // enough for any double in fixed notation
+        auto res = to_chars(tmp, tmp + sizeof(tmp), v, chars_format::fixed, precision);
+        data.append(tmp, res.ptr);
+        return *this;
+    }
+};
+
+// Background thread that writes output files. Pending writes are drained in
+// batches, and each file is opened only once per batch.
+class AsyncOutputWriter {
+private:
+    struct Job {
+        filesystem::path file;
+        string data;
+        bool append;
+    };
+
+    deque<Job> pending;
+    mutex mtx;
+    condition_variable wake;
+    condition_variable drained;
+    bool busy = false;
+    bool stopping = false;
+    vector<filesystem::path> failures; // files that could not be written, until someone collects them
+    thread worker; // declared last so everything above exists before it starts
+
+    // Returns the files that failed to open or write
+    static vector<filesystem::path> writeBatch(deque<Job>& batch) {
+        // Group by file while keeping per-file order; different files are independent
+        vector<pair<filesystem::path, vector<Job*>>> byFile;
+        for (auto& j : batch) {
+            auto it = find_if(byFile.begin(), byFile.end(), [&j](const auto& e) { return e.first == j.file; });
+            if (it == byFile.end()) byFile.push_back({j.file, {&j}});
+            else it->second.push_back(&j);
+        }
+        vector<filesystem::path> failed;
+        for (const auto& [file, jobs] : byFile) {
+            ofstream out;
+            bool ok = true;
+            for (const Job* j : jobs) {
+                if (!j->append) out.close(); // truncate restarts the file
+                if (!out.is_open()) out.open(file, j->append ? ios_base::app : ios_base::trunc);
+                out.write(j->data.data(), static_cast<streamsize>(j->data.size()));
+                ok = ok && out.good();
+            }
+            out.close();
+            if (!ok || out.fail()) failed.push_back(file);
+        }
+        return failed;
+    }
+
+    void run() {
+        unique_lock<mutex> lock(mtx);
+        while (true) {
+            wake.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty()) break; // stopping with nothing left to write
+            deque<Job> batch;
+            batch.swap(pending);
+            busy = true;
+            lock.unlock();
+            vector<filesystem::path> failed;
+            {
+                PhaseTimer timer(Phase::SAVE);
+                failed = writeBatch(batch);
+            }
+            lock.lock();
+            failures.insert(failures.end(), failed.begin(), failed.end());
+            busy = false;
+            if (pending.empty()) drained.notify_all();
+        }
+    }
+
+public:
+    AsyncOutputWriter() : worker(&AsyncOutputWriter::run, this) {}
+    AsyncOutputWriter(const AsyncOutputWriter&) = delete;
+    AsyncOutputWriter& operator=(const AsyncOutputWriter&) = delete;
+
+    ~AsyncOutputWriter() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void enqueue(filesystem::path file, string_view data, bool append) {
+        {
+            lock_guard<mutex> lock(mtx);
+            pending.push_back({move(file), string(data), append});
+        }
+        wake.notify_one();
+    }
+
+    // Blocks until every queued write has reached disk and hands back the files
+    // that failed since the last call.
+    vector<filesystem::path> flush() {
+        unique_lock<mutex> lock(mtx);
+        drained.wait(lock, [this] { return pending.empty() && !busy; });
+        return move(failures);
+    }
+
+    // Failures seen so far, without waiting for pending writes
+    vector<filesystem::path> takeFailures() {
+        lock_guard<mutex> lock(mtx);
+        return move(failures);
+    }
+};
+
 class FileManager {
 private:
-    const filesystem::path inputDir = "../input";
-    const filesystem::path locationsDir = inputDir / "locations";
-    const filesystem::path routesDir = inputDir / "routes";
-    const filesystem::path outputDir = "../output";
-    const filesystem::path txtDir = outputDir / "txt";
-    const filesystem::path csvDir = outputDir / "csv";
+    const filesystem::path inputDir;
+    const filesystem::path locationsDir;
+    const filesystem::path routesDir;
+    const filesystem::path outputDir;
+    const filesystem::path txtDir;
+    const filesystem::path csvDir;
+    const filesystem::path statsDir;
+    mutable OutputBuffer consoleBuffer, txtBuffer, csvBuffer;
+    mutable AsyncOutputWriter writer;
 
     void ensureDirectoriesExist() const {
         filesystem::create_directories(locationsDir);
         filesystem::create_directories(routesDir);
         filesystem::create_directories(txtDir);
         filesystem::create_directories(csvDir);
+        filesystem::create_directories(statsDir);
+    }
+
+    void reportWriteFailures(const vector<filesystem::path>& failed) const {
+        for (const auto& p : failed) {
+            cerr << Color::RED << "Error writing " << p.string() << Color::RESET << endl;
+        }
     }
 
 public:
-    FileManager() {
+    // root holds the input/ and output/ folders; the CLI runs from src/
+    explicit FileManager(const filesystem::path& root = "..")
+        : inputDir(root / "input"), locationsDir(inputDir / "locations"), routesDir(inputDir / "routes"),
+          outputDir(root / "output"), txtDir(outputDir / "txt"), csvDir(outputDir / "csv"),
+          statsDir(outputDir / "stats") {
         ensureDirectoriesExist();
     }
 
-    void loadAllData(Graph& g) const {
+    ~FileManager() {
+        flushOutput();
+    }
+
+    // Waits for background writes and reports any that failed
+    void flushOutput() const {
+        reportWriteFailures(writer.flush());
+    }
+
+    // Reads a CSV file, skips its header and parses the remaining lines on the pool
+    // in line-aligned chunks. Rows come back in file order; parse returns false to skip a line.
+    template <typename Row, typename Parse>
+    static bool parseCsvRows(const string& path, WorkStealingPool& pool, vector<Row>& rows, Parse parse) {
+        ifstream file(path);
+        if (!file.is_open()) return false;
+        string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        size_t bodyStart = content.find('\n');
+        bodyStart = bodyStart == string::npos ? content.size() : bodyStart + 1; // Skip header
+
+        const size_t CHUNK_BYTES = 64 * 1024;
+        vector<pair<size_t, size_t>> chunks;
+        for (size_t b = bodyStart; b < content.size();) {
+            size_t e = content.find('\n', min(content.size(), b + CHUNK_BYTES));
+            e = e == string::npos ? content.size() : e + 1;
+            chunks.push_back({b, e});
+            b = e;
+        }
+        vector<vector<Row>> parsed(chunks.size());
+        pool.parallelFor(chunks.size(), [&](size_t c) {
+            stringstream lines(content.substr(chunks[c].first, chunks[c].second - chunks[c].first));
+            string line;
+            Row row;
+            while (getline(lines, line)) {
+                if (parse(line, row)) parsed[c].push_back(move(row));
+            }
+        });
+        for (auto& part : parsed) move(part.begin(), part.end(), back_inserter(rows));
+        return true;
+    }
+
+    void loadAllData(Graph& g, WorkStealingPool& pool = WorkStealingPool::shared()) const {
         cout << "\n--- Loading All Input Data ---\n";
         if (filesystem::exists(locationsDir)) {
+            PhaseTimer timer(Phase::LOAD_LOCATIONS);
+            struct LocationRow { string name; double lat, lon; };
             for (const auto& entry : filesystem::directory_iterator(locationsDir)) {
                 string path = entry.path().string();
-                ifstream file(path);
-                if (!file.is_open()) continue;
-                string line;
-                getline(file, line); // Skip header
-                while (getline(file, line)) {
+                vector<LocationRow> rows;
+                bool ok = parseCsvRows(path, pool, rows, [](const string& line, LocationRow& r) {
                     stringstream ss(line);
-                    string id, name, lat, lon;
-                    getline(ss, id, ';'); getline(ss, name, ';'); getline(ss, lat, ';'); getline(ss, lon, ';');
-                    if (!name.empty()) { g.addLocation(name, stod(lat), stod(lon)); }
-                }
-                cout << "Loaded locations from " << path << endl;
+                    string id, lat, lon;
+                    getline(ss, id, ';'); getline(ss, r.name, ';'); getline(ss, lat, ';'); getline(ss, lon, ';');
+                    if (r.name.empty()) return false;
+                    r.lat = stod(lat); r.lon = stod(lon);
+                    return true;
+                });
+                if (!ok) continue;
+                // IDs are assigned in file order, so insertion stays sequential
+                for (const auto& r : rows) g.addLocation(r.name, r.lat, r.lon);
+                Instrumentation::instance().recordRows(Phase::LOAD_LOCATIONS, rows.size());
+                cout << "Loaded locations from " << path << " (" << rows.size() << " rows)" << endl;
             }
         }
         if (filesystem::exists(routesDir)) {
+            PhaseTimer timer(Phase::LOAD_ROUTES);
+            struct RouteRow { int src, dest; double dist, time, cost; TransportationType type; };
             for (const auto& entry : filesystem::directory_iterator(routesDir)) {
                 string path = entry.path().string();
-                ifstream file(path);
-                if (!file.is_open()) continue;
-                string line;
-                getline(file, line); // Skip header
-                while (getline(file, line)) {
+                vector<RouteRow> rows;
+                bool ok = parseCsvRows(path, pool, rows, [](const string& line, RouteRow& r) {
                     stringstream ss(line);
                     string src, dest, dist, time, cost, type;
                     getline(ss, src, ';'); getline(ss, dest, ';'); getline(ss, dist, ';'); getline(ss, time, ';'); getline(ss, cost, ';'); getline(ss, type, ';');
-                    if (!src.empty()) { g.addRoute(stoi(src), stoi(dest), stod(dist), stod(time), stod(cost), stringToTransportType(type));}
-                }
-                cout << "Loaded routes from " << path << endl;
+                    if (src.empty()) return false;
+                    r = {stoi(src), stoi(dest), stod(dist), stod(time), stod(cost), stringToTransportType(type)};
+                    return true;
+                });
+                if (!ok) continue;
+                for (const auto& r : rows) g.addRoute(r.src, r.dest, r.dist, r.time, r.cost, r.type);
+                Instrumentation::instance().recordRows(Phase::LOAD_ROUTES, rows.size());
+                cout << "Loaded routes from " << path << " (" << rows.size() << " rows)" << endl;
             }
         }
         cout << "----------------------------\n";
@@ -519,89 +1723,102 @@ public:
         cout << Color::GREEN << "Routes saved to " << (routesDir / f).string() << Color::RESET << endl;
     }
     
-    // This version is for the colorful console output
-    string formatTxtOutputForConsole(const vector<shared_ptr<const Route>>& p) const {
-        if (p.empty()) return "No path.";
-        stringstream s;
-        double tT = 0, tC = 0, tD = 0;
-        s << Color::CYAN << "========================================\n";
-        s << "      R E C O M M E N D E D   R O U T E\n";
-        s << "========================================\n" << Color::RESET;
-        s << Color::WHITE << "From: " << p.front()->getSource()->getName() << "\n" << "To:   " << p.back()->getDestination()->getName() << "\n\n" << Color::YELLOW << "--- Steps ---\n" << Color::RESET;
-        for (size_t i = 0; i < p.size(); ++i) {
-            const auto& r = p[i];
-            s << "  " << i + 1 << ". From " << r->getSource()->getName() << " to " << r->getDestination()->getName() << " by " << transportTypeToString(r->getType()) << "\n     (Time: " << r->getTime() << "m, Cost: " << r->getCost() << "k, Dist: " << r->getDistance() << "m)\n";
-            tT += r->getTime(); tC += r->getCost(); tD += r->getDistance();
-        }
-        s << Color::YELLOW << "\n--- Summary ---\n" << Color::RESET;
-        s << "  Total Time:     " << tT << " min\n";
-        s << "  Total Distance: " << tD << " m\n";
-        s << "  Total Cost:     Rp " << fixed << setprecision(3) << (tC * 1000) << "\n";
-        s << Color::CYAN << "========================================\n" << Color::RESET;
-        return s.str();
+    // Single formatter for every output flavour; writes into a reusable buffer
+    // instead of building a fresh stringstream per call.
+    template <OutputFormat F>
+    void formatPath(OutputBuffer& s, const vector<shared_ptr<const Route>>& p) const {
+        if constexpr (F == OutputFormat::CSV) {
+            s << "start_id,start_name,end_id,end_name,type,time,cost,dist\n";
+            for (const auto& r : p) {
+                s << r->getSource()->getId() << ',' << r->getSource()->getName() << ',' << r->getDestination()->getId() << ',' << r->getDestination()->getName() << ',' << transportTypeToString(r->getType()) << ',' << r->getTime() << ',' << r->getCost() << ',' << r->getDistance() << '\n';
+            }
+        } else {
+            // Console output is colored; the file version must stay free of escape codes
+            auto color = [&s](const string& c) { if constexpr (F == OutputFormat::CONSOLE_TXT) s << c; };
+            if (p.empty()) { s << "No path."; return; }
+            double tT = 0, tC = 0, tD = 0;
+            color(Color::CYAN);
+            s << "========================================\n";
+            s << "      R E C O M M E N D E D   R O U T E\n";
+            s << "========================================\n";
+            color(Color::RESET); color(Color::WHITE);
+            s << "From: " << p.front()->getSource()->getName() << '\n' << "To:   " << p.back()->getDestination()->getName() << "\n\n";
+            color(Color::YELLOW); s << "--- Steps ---\n"; color(Color::RESET);
+            for (size_t i = 0; i < p.size(); ++i) {
+                const auto& r = p[i];
+                s << "  " << i + 1 << ". From " << r->getSource()->getName() << " to " << r->getDestination()->getName() << " by " << transportTypeToString(r->getType()) << "\n     (Time: " << r->getTime() << "m, Cost: " << r->getCost() << "k, Dist: " << r->getDistance() << "m)\n";
+                tT += r->getTime(); tC += r->getCost(); tD += r->getDistance();
+            }
+            color(Color::YELLOW); s << "\n--- Summary ---\n"; color(Color::RESET);
+            s << "  Total Time:     " << tT << " min\n";
+            s << "  Total Distance: " << tD << " m\n";
+            s << "  Total Cost:     Rp "; s.appendFixed(tC * 1000, 3); s << '\n';
+            color(Color::CYAN); s << "========================================\n"; color(Color::RESET);
+        }
     }
-    
-    // ##############################################################################
-    // #
-    // #   THE FIX FOR THE FILE OUTPUT IS HERE
-    // #
-    // #   This new function creates a plain text string with NO color codes,
-    // #   making it suitable for saving to a .txt file.
-    // #
-    string formatTxtOutputForFile(const vector<shared_ptr<const Route>>& p) const {
-        if (p.empty()) return "No path.";
-        stringstream s;
-        double tT = 0, tC = 0, tD = 0;
-        s << "========================================\n";
-        s << "      R E C O M M E N D E D   R O U T E\n";
-        s << "========================================\n";
-        s << "From: " << p.front()->getSource()->getName() << "\n" << "To:   " << p.back()->getDestination()->getName() << "\n\n" << "--- Steps ---\n";
-        for (size_t i = 0; i < p.size(); ++i) {
-            const auto& r = p[i];
-            s << "  " << i + 1 << ". From " << r->getSource()->getName() << " to " << r->getDestination()->getName() << " by " << transportTypeToString(r->getType()) << "\n     (Time: " << r->getTime() << "m, Cost: " << r->getCost() << "k, Dist: " << r->getDistance() << "m)\n";
-            tT += r->getTime(); tC += r->getCost(); tD += r->getDistance();
-        }
-        s << "\n--- Summary ---\n";
-        s << "  Total Time:     " << tT << " min\n";
-        s << "  Total Distance: " << tD << " m\n";
-        s << "  Total Cost:     Rp " << fixed << setprecision(3) << (tC * 1000) << "\n";
-        s << "========================================\n";
-        return s.str();
+
+    void printPath(const vector<shared_ptr<const Route>>& p) const {
+        PhaseTimer timer(Phase::FORMAT);
+        consoleBuffer.clear();
+        formatPath<OutputFormat::CONSOLE_TXT>(consoleBuffer, p);
+        cout << consoleBuffer.view();
     }
-    // #
-    // ##############################################################################
 
-    string formatCsvOutput(const vector<shared_ptr<const Route>>& p) const {
-        stringstream s;
-        s << "start_id,start_name,end_id,end_name,type,time,cost,dist\n";
-        for (const auto& r : p) {
-            s << r->getSource()->getId() << "," << r->getSource()->getName() << "," << r->getDestination()->getId() << "," << r->getDestination()->getName() << "," << transportTypeToString(r->getType()) << "," << r->getTime() << "," << r->getCost() << "," << r->getDistance() << "\n";
+    // Formats every path in [first, last) into one txt and one csv payload and saves them.
+    template <typename It>
+    void savePaths(const string& b, It first, It last, bool a = false) const {
+        txtBuffer.clear();
+        csvBuffer.clear();
+        {
+            PhaseTimer timer(Phase::FORMAT);
+            for (It it = first; it != last; ++it) {
+                formatPath<OutputFormat::FILE_TXT>(txtBuffer, *it);
+                formatPath<OutputFormat::CSV>(csvBuffer, *it);
+            }
         }
-        return s.str();
+        txtBuffer << '\n';
+        saveOutput(b, txtBuffer.view(), csvBuffer.view(), a);
     }
 
-    void saveOutput(const string& b, const string& t, const string& c, bool a = false) const {
+    void saveOutput(const string& b, string_view t, string_view c, bool a = false) const {
         filesystem::path tf = txtDir / (b + ".txt");
         filesystem::path cf = csvDir / (b + ".csv");
-        ofstream tO, cO;
-        if (a) {
-            tO.open(tf, ios_base::app);
-            cO.open(cf, ios_base::app);
-        } else {
-            tO.open(tf);
-            cO.open(cf);
+        reportWriteFailures(writer.takeFailures());
+        writer.enqueue(tf, t, a);
+        writer.enqueue(cf, c, a);
+        cout << Color::GREEN << "Queued output for " << tf.string() << " and " << cf.string() << " (written in the background)" << Color::RESET << endl;
+    }
+
+    void saveStats(const string& f) const {
+        filesystem::path sf = statsDir / f;
+        ofstream file(sf);
+        Instrumentation::instance().report(file);
+        cout << Color::GREEN << "Statistics saved to " << sf.string() << Color::RESET << endl;
+    }
+
+    // One row per search event with coordinates, ready for any lat/lon scatter plot.
+    void saveTrace(const Graph& g, const SearchTrace& tr, const string& f) const {
+        filesystem::path tf = statsDir / f;
+        OutputBuffer b;
+        b << "step;event;id;name;latitude;longitude;g;f\n";
+        for (const auto& e : tr.entries) {
+            const Location& loc = g.getAllLocations().at(e.id);
+            string_view ev = e.event == SearchTrace::Event::PUSH ? "push" : e.event == SearchTrace::Event::EXPAND ? "expand" : "stale";
+            b << e.step << ';' << ev << ';' << e.id << ';' << loc.getName() << ';' << loc.getLatitude() << ';' << loc.getLongitude() << ';' << e.g << ';' << e.f << '\n';
         }
-        tO << t << "\n";
-        cO << c;
-        cout << Color::GREEN << "Saved output to " << tf.string() << " and " << cf.string() << Color::RESET << endl;
+        reportWriteFailures(writer.takeFailures());
+        writer.enqueue(tf, b.view(), false);
+        cout << Color::GREEN << "Search trace (" << tr.entries.size() << " events) queued for " << tf.string() << Color::RESET << endl;
     }
 
     void listFiles(const string& t) const {
+        flushOutput();
         filesystem::path d;
         if (t == "input_locations") d = locationsDir;
         else if (t == "input_routes") d = routesDir;
         else if (t == "output_txt") d = txtDir;
         else if (t == "output_csv") d = csvDir;
+        else if (t == "output_stats") d = statsDir;
         else {
             cout << Color::RED << "Invalid type." << Color::RESET << endl;
             return;
@@ -614,8 +1831,9 @@ public:
     }
 
     void deleteFile() const {
+        flushOutput();
         string t, f;
-        cout << "Type to delete? (input_locations, input_routes, output_txt, output_csv): ";
+        cout << "Type to delete? (input_locations, input_routes, output_txt, output_csv, output_stats): ";
         cin >> t;
         listFiles(t);
         cout << "Filename to delete: ";
@@ -625,6 +1843,7 @@ public:
         else if (t == "input_routes") p = routesDir / f;
         else if (t == "output_txt") p = txtDir / f;
         else if (t == "output_csv") p = csvDir / f;
+        else if (t == "output_stats") p = statsDir / f;
         else {
             cout << Color::RED << "Invalid type." << Color::RESET << endl;
             return;
@@ -665,6 +1884,70 @@ void cli_deleteRoute(Graph& g) { /* ... same as before ... */
     if (g.deleteRoute(s, d)) { cout << Color::GREEN << "Route deleted." << Color::RESET << "\n"; }
     else { cout << Color::RED << "Not found." << Color::RESET << "\n"; }
 }
+// Reads start/goal either as location IDs or as coordinates snapped to the nearest stop
+void cli_selectStops(const Graph& g, int& startId, int& goalId) {
+    int mode = 1;
+    cout << "Select stops by (1) Location ID or (2) Coordinates: "; cin >> mode;
+    if (mode == 2) {
+        double sLa, sLo, gLa, gLo;
+        cout << "Start Lat: "; cin >> sLa; cout << "Start Lon: "; cin >> sLo;
+        cout << "Goal Lat: "; cin >> gLa; cout << "Goal Lon: "; cin >> gLo;
+        startId = g.snapToNearestLocation(sLa, sLo);
+        goalId = g.snapToNearestLocation(gLa, gLo);
+        if (startId && goalId) {
+            cout << "Snapped to " << g.getAllLocations().at(startId).getName() << " -> " << g.getAllLocations().at(goalId).getName() << "\n";
+        }
+    } else {
+        g.printAllLocations();
+        cout << "Enter Start ID: "; cin >> startId;
+        cout << "Enter Goal ID: "; cin >> goalId;
+    }
+}
+void cli_findNearestLocations(const Graph& g) {
+    double la, lo; cout << "Lat: "; cin >> la; cout << "Lon: "; cin >> lo;
+    cout << "Search by (1) nearest count or (2) radius in km: "; int mode; cin >> mode;
+    vector<pair<double, int>> found;
+    if (mode == 2) { double r; cout << "Radius (km): "; cin >> r; found = g.findLocationsWithinRadius(la, lo, r); }
+    else { size_t k; cout << "How many: "; cin >> k; found = g.findNearestLocations(la, lo, k); }
+    cout << "\n--- Nearby Locations ---\n";
+    if (found.empty()) { cout << "No locations found.\n"; }
+    // Distances go through a local buffer so cout's own format flags stay untouched
+    OutputBuffer km;
+    for (const auto& [dist, id] : found) {
+        km.clear();
+        km.appendFixed(dist, 2);
+        string_view name = g.getAllLocations().at(id).getName();
+        cout << "ID: " << id << "\t-> " << name << string(name.size() < 20 ? 20 - name.size() : 0, ' ') << km.view() << " km" << endl;
+    }
+    cout << "------------------------\n";
+}
+void cli_showStatistics(const FileManager& f, bool& traceNextQuery) {
+    Instrumentation& inst = Instrumentation::instance();
+    int c = -1;
+    while (c != 0) {
+        cout << "\n--- Search & Load Statistics ---\n";
+        inst.report(cout);
+        cout << "Trace next query: " << (traceNextQuery ? "on" : "off") << "\n";
+        cout << "--------------------------------\n";
+        cout << "(1) Save to file  (2) Reset  (3) Toggle collection  (4) Toggle trace of next query  (0) Back: ";
+        cin >> c;
+        if (cin.fail()) { cin.clear(); cin.ignore(numeric_limits<streamsize>::max(), '\n'); c = -1; }
+        switch (c) {
+            case 1: f.saveStats("stats.txt"); break;
+            case 2: inst.reset(); break;
+            case 3:
+                if (!MAPS_STATS) cout << Color::YELLOW << "Instrumentation was compiled out (MAPS_STATS=0).\n" << Color::RESET;
+                inst.setEnabled(!inst.isEnabled());
+                break;
+            case 4:
+                if (!MAPS_STATS) cout << Color::YELLOW << "Query tracing was compiled out (MAPS_STATS=0).\n" << Color::RESET;
+                traceNextQuery = !traceNextQuery && MAPS_STATS;
+                break;
+            case 0: break;
+            default: cout << Color::RED << "Invalid choice." << Color::RESET << "\n"; break;
+        }
+    }
+}
 void cli_showRecommendedPaths(const vector<vector<shared_ptr<const Route>>>& h, const FileManager& f) {
     cout << "\n--- Recommended Path History ---\n";
     if (h.empty()) {
@@ -672,7 +1955,7 @@ void cli_showRecommendedPaths(const vector<vector<shared_ptr<const Route>>>& h,
     } else {
         for (size_t i = 0; i < h.size(); ++i) {
             cout << "--- History Item #" << i + 1 << " ---\n";
-            cout << f.formatTxtOutputForConsole(h[i]);
+            f.printPath(h[i]);
         }
     }
     cout << "--------------------------------\n";
@@ -697,19 +1980,497 @@ void cli_printMenu() { /* ... same as before ... */
          << Color::WHITE << "\nFile Management:\n" << Color::RESET
          << Color::GREEN << "  13. " << Color::WHITE << "Save Current Graph Data to File\n"
          << Color::GREEN << "  14. " << Color::WHITE << "Delete a File\n"
+         << Color::WHITE << "\nTools:\n" << Color::RESET
+         << Color::GREEN << "  15. " << Color::WHITE << "Find Nearest Locations\n"
+         << Color::GREEN << "  16. " << Color::WHITE << "Search Statistics & Tracing\n"
+         << Color::GREEN << "  17. " << Color::WHITE << "Recommend a Path (Island Overlay Engine)\n"
          << Color::RED << "\n  0. Exit\n" << Color::RESET
          << Color::YELLOW << "=========================================\n" << Color::RESET
          << Color::MAGENTA << "Enter your choice: " << Color::RESET;
 }
 
 // =================================================================================
-// 6. MAIN PROGRAM FLOW (CLI)
+// 6. BENCHMARK SUITE & SYNTHETIC DATA GENERATOR
 // =================================================================================
-int main() {
+struct SyntheticNetworkSpec {
+    int locations = 2000;
+    int routes = 10000;
+    int islands = 8;
+    double interIslandShare = 0.05; // share of random routes crossing islands (boat/plane)
+    unsigned seed = 42;
+};
+
+// Writes a reproducible island-clustered network under root/input in the same
+// CSV schema as input_locations / input_routes. Refuses a root whose input
+// folders contain anything but a previous synthetic network.
+void generateSyntheticNetwork(const SyntheticNetworkSpec& spec, const filesystem::path& root) {
+    mt19937 rng(spec.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    int islands = max(1, min(spec.islands, spec.locations));
+
+    // Island centres inside Indonesia's bounding box, stops scattered around them
+    vector<pair<double, double>> centres;
+    for (int k = 0; k < islands; ++k) {
+        centres.push_back({-11.0 + 17.0 * unit(rng), 95.0 + 46.0 * unit(rng)});
+    }
+    normal_distribution<double> spread(0.0, 1.0);
+    vector<pair<double, double>> coords(spec.locations + 1);
+    vector<vector<int>> members(islands);
+    for (int id = 1; id <= spec.locations; ++id) {
+        int k = (id - 1) % islands;
+        coords[id] = {centres[k].first + spread(rng), centres[k].second + spread(rng)};
+        members[k].push_back(id);
+    }
+
+    // Never overwrite or mix with real data: only our own output may already be there
+    const filesystem::path locationsFile = root / "input" / "locations" / "synthetic_locations.csv";
+    const filesystem::path routesFile = root / "input" / "routes" / "synthetic_routes.csv";
+    for (const auto& file : {locationsFile, routesFile}) {
+        if (!filesystem::exists(file.parent_path())) continue;
+        for (const auto& e : filesystem::directory_iterator(file.parent_path())) {
+            if (e.path().filename() != file.filename()) {
+                throw runtime_error(file.parent_path().string() + " already holds other data; choose an empty --dir");
+            }
+        }
+    }
+    filesystem::create_directories(locationsFile.parent_path());
+    filesystem::create_directories(routesFile.parent_path());
+    ofstream lf(locationsFile);
+    lf << "id;name;latitude;longitude\n" << fixed << setprecision(4);
+    for (int id = 1; id <= spec.locations; ++id) {
+        lf << id << ";Stop " << id << ";" << coords[id].first << ";" << coords[id].second << "\n";
+    }
+
+    ofstream rf(routesFile);
+    rf << "source;destination;distance;time;cost;transportationType\n" << fixed << setprecision(2);
+    int written = 0;
+    auto emit = [&](int s, int d, TransportationType t) {
+        if (written >= spec.routes || s == d) return;
+        struct Mode { double kmh, overheadMin, kRpPerKm, baseKRp; };
+        static const map<TransportationType, Mode> modes = {
+            {TransportationType::BUS, {50, 10, 0.8, 5}},
+            {TransportationType::TRAIN, {80, 15, 1.0, 10}},
+            {TransportationType::BOAT, {30, 60, 0.6, 50}},
+            {TransportationType::PLANE, {600, 90, 2.0, 300}},
+        };
+        const Mode& m = modes.at(t);
+        double km = haversineKm(coords[s].first, coords[s].second, coords[d].first, coords[d].second) * (1.1 + 0.3 * unit(rng));
+        rf << s << ";" << d << ";" << km * 1000 << ";" << m.overheadMin + km / m.kmh * 60 << ";" << m.baseKRp + km * m.kRpPerKm << ";" << transportTypeToString(t) << "\n";
+        ++written;
+    };
+    auto landMode = [&]() { return unit(rng) < 0.6 ? TransportationType::BUS : TransportationType::TRAIN; };
+    auto seaOrAir = [&]() { return unit(rng) < 0.5 ? TransportationType::BOAT : TransportationType::PLANE; };
+
+    // Backbone: a two-way chain inside each island plus a ring of island hubs,
+    // so most OD pairs are reachable before the random edges are added
+    for (const auto& m : members) {
+        for (size_t i = 1; i < m.size(); ++i) {
+            TransportationType t = landMode();
+            emit(m[i - 1], m[i], t);
+            emit(m[i], m[i - 1], t);
+        }
+    }
+    for (int k = 0; islands > 1 && k < islands; ++k) {
+        TransportationType t = seaOrAir();
+        int a = members[k].front(), b = members[(k + 1) % islands].front();
+        emit(a, b, t);
+        emit(b, a, t);
+    }
+    while (written < spec.routes && spec.locations > 1) {
+        int s = 1 + static_cast<int>(rng() % spec.locations);
+        int k = (s - 1) % islands;
+        if (islands > 1 && unit(rng) < spec.interIslandShare) {
+            int other = (k + 1 + static_cast<int>(rng() % (islands - 1))) % islands;
+            emit(s, members[other][rng() % members[other].size()], seaOrAir());
+        } else {
+            emit(s, members[k][rng() % members[k].size()], landMode());
+        }
+    }
+}
+
+struct LatencySummary {
+    size_t count = 0;
+    double p50Us = 0, p99Us = 0, meanUs = 0, opsPerSec = 0;
+};
+
+LatencySummary summarizeLatencies(vector<double> samplesUs) {
+    LatencySummary r;
+    if (samplesUs.empty()) return r;
+    sort(samplesUs.begin(), samplesUs.end());
+    double total = 0;
+    for (double v : samplesUs) total += v;
+    auto rank = [&samplesUs](double q) { // nearest-rank percentile
+        size_t idx = static_cast<size_t>(ceil(q * samplesUs.size()));
+        return samplesUs[min(samplesUs.size(), max<size_t>(idx, 1)) - 1];
+    };
+    r.count = samplesUs.size();
+    r.p50Us = rank(0.50);
+    r.p99Us = rank(0.99);
+    r.meanUs = total / r.count;
+    r.opsPerSec = total > 0 ? r.count / (total / 1e6) : 0;
+    return r;
+}
+
+template <typename F>
+double timeMicros(F&& f) {
+    auto t0 = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+}
+
+long peakRssKb() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage u{};
+    getrusage(RUSAGE_SELF, &u);
+#if defined(__APPLE__)
+    return u.ru_maxrss / 1024; // bytes on macOS
+#else
+    return u.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Plain Dijkstra path cost, used to cross-check the faster engines. INF when unreachable.
+double referencePathCost(const Graph& g, int s, int t, const UserPreferences& pr) {
+    unordered_map<int, double> dist{{s, 0.0}};
+    using QE = pair<double, int>;
+    priority_queue<QE, vector<QE>, greater<QE>> pq;
+    pq.push({0.0, s});
+    while (!pq.empty()) {
+        auto [d, u] = pq.top();
+        pq.pop();
+        if (u == t) return d;
+        if (d > dist[u]) continue;
+        auto it = g.getAdjList().find(u);
+        if (it == g.getAdjList().end()) continue;
+        for (const auto& r : it->second) {
+            int v = r->getDestination()->getId();
+            double nd = d + r->calculateWeight(pr, g.getStats());
+            auto [dv, inserted] = dist.try_emplace(v, nd);
+            if (inserted || nd < dv->second) {
+                dv->second = nd;
+                pq.push({nd, v});
+            }
+        }
+    }
+    return numeric_limits<double>::infinity();
+}
+
+double pathCost(const vector<shared_ptr<const Route>>& path, const Graph& g, const UserPreferences& pr) {
+    double c = 0;
+    for (const auto& r : path) c += r->calculateWeight(pr, g.getStats());
+    return c;
+}
+
+// Mutes cout for the timed sections (the graph and loader print progress text)
+struct ScopedCoutSilencer {
+    streambuf* saved;
+    ScopedCoutSilencer() : saved(cout.rdbuf(nullptr)) {}
+    ~ScopedCoutSilencer() { cout.rdbuf(saved); }
+};
+
+// extra is spliced in as additional ", \"key\": value" members of the object
+void appendLatencyJson(OutputBuffer& j, string_view key, const LatencySummary& l, string_view indent, string_view extra = {}) {
+    j << indent << '"' << key << "\": {\"count\": " << l.count << ", \"p50_us\": " << l.p50Us << ", \"p99_us\": " << l.p99Us
+      << ", \"mean_us\": " << l.meanUs << ", \"ops_per_sec\": " << l.opsPerSec << extra << '}';
+}
+
+struct BenchmarkOptions {
+    SyntheticNetworkSpec spec;
+    int queries = 200;    // OD pairs per preference profile
+    int crudOps = 200;    // operations per CRUD kind
+    int loadRepeats = 5;
+    int maxThreads = 0;   // scaling report from 1 up to this many threads; 0 skips it
+    bool existing = false; // benchmark the data already under workDir (default "..") instead of generating
+    filesystem::path workDir;
+    string outFile;       // empty -> stdout only
+};
+
+int runBenchmark(const BenchmarkOptions& opt) {
+    filesystem::path root = !opt.workDir.empty() ? opt.workDir
+        : opt.existing ? filesystem::path("..")
+        : filesystem::temp_directory_path() / ("maps_bench_" + to_string(opt.spec.seed));
+    if (!opt.existing) generateSyntheticNetwork(opt.spec, root);
+    FileManager fm(root);
+    DecisionTree tree;
+    mt19937 rng(opt.spec.seed);
+
+    // loadAllData
+    Graph g;
+    vector<double> loadUs;
+    {
+        ScopedCoutSilencer quiet;
+        for (int i = 0; i < max(1, opt.loadRepeats); ++i) {
+            Graph fresh;
+            loadUs.push_back(timeMicros([&] { fm.loadAllData(fresh); }));
+        }
+        fm.loadAllData(g);
+    }
+    LatencySummary load = summarizeLatencies(loadUs);
+    size_t routeCount = 0;
+    for (const auto& p : g.getAdjList()) routeCount += p.second.size();
+    double rows = g.getAllLocations().size() + routeCount;
+
+    OutputBuffer j(1 << 14);
+    if (opt.existing) {
+        // The generator settings do not describe this data; report where it came from and what was loaded
+        string dataset;
+        for (char ch : filesystem::absolute(root).lexically_normal().generic_string()) {
+            if (ch == '"' || ch == '\\') dataset += '\\';
+            dataset += ch;
+        }
+        j << "{\n  \"config\": {\"dataset\": \"" << dataset << "\", \"locations\": " << g.getAllLocations().size() << ", \"routes\": " << routeCount;
+    } else {
+        j << "{\n  \"config\": {\"dataset\": \"generated\", \"locations\": " << opt.spec.locations << ", \"routes\": " << opt.spec.routes
+          << ", \"islands\": " << opt.spec.islands << ", \"inter_island_share\": " << opt.spec.interIslandShare;
+    }
+    j << ", \"queries_per_profile\": " << opt.queries << ", \"crud_ops\": " << opt.crudOps << ", \"seed\": " << opt.spec.seed << "},\n  \"results\": {\n";
+    j << "    \"loaded\": {\"locations\": " << g.getAllLocations().size() << ", \"routes\": " << routeCount << "},\n";
+    appendLatencyJson(j, "load_all_data", load, "    ");
+    j << ",\n    \"load_rows_per_sec\": " << (load.meanUs > 0 ? rows / (load.meanUs / 1e6) : 0.0) << ",\n";
+
+    // findShortestPath over random OD pairs for every profile
+    vector<int> ids;
+    for (const auto& p : g.getAllLocations()) ids.push_back(p.first);
+    vector<pair<int, int>> od;
+    for (int i = 0; i < opt.queries && !ids.empty(); ++i) {
+        od.push_back({ids[rng() % ids.size()], ids[rng() % ids.size()]});
+    }
+    vector<vector<shared_ptr<const Route>>> samplePaths;
+    j << "    \"find_shortest_path\": {\n";
+    vector<UserPreferences> profiles = tree.getProfiles();
+    for (size_t pi = 0; pi < profiles.size(); ++pi) {
+        vector<double> us;
+        size_t found = 0;
+        {
+            ScopedCoutSilencer quiet;
+            for (const auto& [s, d] : od) {
+                vector<shared_ptr<const Route>> path;
+                us.push_back(timeMicros([&] { path = g.findShortestPath(s, d, profiles[pi]); }));
+                if (!path.empty()) {
+                    ++found;
+                    if (samplePaths.size() < 64) samplePaths.push_back(path);
+                }
+            }
+        }
+        string extra = ", \"paths_found\": " + to_string(found);
+        appendLatencyJson(j, profiles[pi].profileName, summarizeLatencies(us), "      ", extra);
+        j << (pi + 1 < profiles.size() ? ",\n" : "\n");
+    }
+    j << "    },\n";
+
+    // Island overlay: partition once, customize per profile, then the same OD pairs
+    OverlayRouter overlay(g);
+    double partitionUs = timeMicros([&] { overlay.prepare(); });
+    j << "    \"overlay\": {\"cells\": " << overlay.getCellCount() << ", \"partition_us\": " << partitionUs << ",\n";
+    for (size_t pi = 0; pi < profiles.size(); ++pi) {
+        double customizeUs = timeMicros([&] { overlay.prepareProfile(profiles[pi]); });
+        vector<double> us;
+        size_t mismatches = 0;
+        {
+            ScopedCoutSilencer quiet;
+            for (const auto& [s, d] : od) {
+                vector<shared_ptr<const Route>> path;
+                us.push_back(timeMicros([&] { path = overlay.findShortestPath(s, d, profiles[pi]); }));
+                // Outside the timed call: the overlay must agree with plain Dijkstra on cost
+                double ref = referencePathCost(g, s, d, profiles[pi]);
+                double got = s == d ? 0.0 : (path.empty() ? numeric_limits<double>::infinity() : pathCost(path, g, profiles[pi]));
+                if (isinf(ref) != isinf(got) || (!isinf(ref) && fabs(ref - got) > 1e-9 * max(1.0, ref))) ++mismatches;
+            }
+        }
+        string extra = ", \"customize_us\": " + to_string(customizeUs) + ", \"mismatches\": " + to_string(mismatches);
+        appendLatencyJson(j, profiles[pi].profileName, summarizeLatencies(us), "      ", extra);
+        j << (pi + 1 < profiles.size() ? ",\n" : "\n");
+    }
+    j << "    },\n";
+
+    // Speedup of the pool-backed stages from 1 to maxThreads threads
+    if (opt.maxThreads > 0) {
+        vector<size_t> counts;
+        for (size_t t = 1; t < static_cast<size_t>(opt.maxThreads); t *= 2) counts.push_back(t);
+        counts.push_back(opt.maxThreads);
+        double base[4] = {0, 0, 0, 0};
+        j << "    \"scaling\": [\n";
+        for (size_t ti = 0; ti < counts.size(); ++ti) {
+            WorkStealingPool pool(counts[ti]);
+            double us[4] = {numeric_limits<double>::infinity(), 0, 0, 0};
+            {
+                ScopedCoutSilencer quiet;
+                for (int rep = 0; rep < max(1, opt.loadRepeats); ++rep) {
+                    Graph fresh;
+                    us[0] = min(us[0], timeMicros([&] { fm.loadAllData(fresh, pool); }));
+                }
+            }
+            OverlayRouter fresh(g);
+            fresh.prepare();
+            us[1] = timeMicros([&] { for (const auto& pr : profiles) fresh.prepareProfile(pr, pool); });
+            us[2] = timeMicros([&] { for (const auto& pr : profiles) g.findShortestPaths(od, pr, pool); });
+            us[3] = timeMicros([&] { for (const auto& pr : profiles) fresh.findShortestPaths(od, pr, pool); });
+            if (ti == 0) copy(us, us + 4, base);
+            const char* names[4] = {"load", "customize", "astar_batch", "overlay_batch"};
+            j << "      {\"threads\": " << counts[ti];
+            for (int k = 0; k < 4; ++k) {
+                j << ", \"" << names[k] << "_us\": " << us[k] << ", \"" << names[k] << "_speedup\": " << (us[k] > 0 ? base[k] / us[k] : 0.0);
+            }
+            j << '}' << (ti + 1 < counts.size() ? ",\n" : "\n");
+        }
+        j << "    ],\n";
+    }
+
+    // Output formatting on the paths found above
+    j << "    \"format\": {\n";
+    OutputBuffer fb;
+    auto benchFormat = [&](auto tag) {
+        vector<double> us;
+        for (int rep = 0; rep < 20; ++rep) {
+            for (const auto& p : samplePaths) {
+                us.push_back(timeMicros([&] { fb.clear(); fm.formatPath<decltype(tag)::value>(fb, p); }));
+            }
+        }
+        return summarizeLatencies(us);
+    };
+    appendLatencyJson(j, "console_txt", benchFormat(integral_constant<OutputFormat, OutputFormat::CONSOLE_TXT>{}), "      ");
+    j << ",\n";
+    appendLatencyJson(j, "file_txt", benchFormat(integral_constant<OutputFormat, OutputFormat::FILE_TXT>{}), "      ");
+    j << ",\n";
+    appendLatencyJson(j, "csv", benchFormat(integral_constant<OutputFormat, OutputFormat::CSV>{}), "      ");
+    j << "\n    },\n";
+
+    // CRUD
+    vector<double> addL, updL, addR, delR, delL;
+    vector<int> added;
+    vector<pair<int, int>> addedRoutes;
+    {
+        ScopedCoutSilencer quiet;
+        for (int i = 0; i < opt.crudOps; ++i) {
+            double la = -11.0 + 17.0 * (rng() % 1000) / 1000.0, lo = 95.0 + 46.0 * (rng() % 1000) / 1000.0;
+            int id = 0;
+            addL.push_back(timeMicros([&] { id = g.addLocation("Bench " + to_string(i), la, lo); }));
+            added.push_back(id);
+        }
+        for (int id : added) {
+            updL.push_back(timeMicros([&] { g.updateLocation(id, "Bench Updated", -6.0, 107.0); }));
+        }
+        for (int i = 0; i < opt.crudOps && !ids.empty(); ++i) {
+            int s = added[i % added.size()], d = ids[rng() % ids.size()];
+            addR.push_back(timeMicros([&] { g.addRoute(s, d, 1000.0, 10.0, 10.0, TransportationType::BUS); }));
+            addedRoutes.push_back({s, d});
+        }
+        for (const auto& [s, d] : addedRoutes) {
+            delR.push_back(timeMicros([&] { g.deleteRoute(s, d); }));
+        }
+        for (int id : added) {
+            delL.push_back(timeMicros([&] { g.deleteLocation(id); }));
+        }
+    }
+    j << "    \"crud\": {\n";
+    appendLatencyJson(j, "add_location", summarizeLatencies(addL), "      "); j << ",\n";
+    appendLatencyJson(j, "update_location", summarizeLatencies(updL), "      "); j << ",\n";
+    appendLatencyJson(j, "add_route", summarizeLatencies(addR), "      "); j << ",\n";
+    appendLatencyJson(j, "delete_route", summarizeLatencies(delR), "      "); j << ",\n";
+    appendLatencyJson(j, "delete_location", summarizeLatencies(delL), "      "); j << "\n";
+    j << "    }\n  },\n  \"name_arena\": {\"names\": " << NameTable::instance().size() << ", \"bytes\": " << NameTable::instance().bytes() << "},\n";
+    j << "  \"peak_rss_kb\": " << peakRssKb() << "\n}\n";
+
+    cout << j.view();
+    if (!opt.outFile.empty()) {
+        ofstream out(opt.outFile);
+        out << j.view();
+    }
+    return 0;
+}
+
+// Parses "--bench" / "--generate" command-line options. Returns false on a bad flag,
+// a malformed number or a value outside the supported range.
+bool parseBenchmarkArgs(int argc, char* argv[], BenchmarkOptions& opt) {
+    // long long so the unsigned seed range fits where long is 32 bits (e.g. Windows)
+    auto toLong = [](const string& v, long long lo, long long hi, long long& out) {
+        try {
+            size_t used = 0;
+            out = stoll(v, &used);
+            return used == v.size() && out >= lo && out <= hi;
+        } catch (const logic_error&) { // invalid_argument / out_of_range
+            return false;
+        }
+    };
+    for (int i = 2; i < argc; ++i) {
+        string flag = argv[i];
+        if (flag == "--existing") { opt.existing = true; continue; }
+        if (i + 1 >= argc) return false;
+        string value = argv[++i];
+        long long n = 0;
+        bool ok = true;
+        if (flag == "--locations") { ok = toLong(value, 1, 10000000, n); opt.spec.locations = static_cast<int>(n); }
+        else if (flag == "--routes") { ok = toLong(value, 0, 100000000, n); opt.spec.routes = static_cast<int>(n); }
+        else if (flag == "--islands") { ok = toLong(value, 1, 100000, n); opt.spec.islands = static_cast<int>(n); }
+        else if (flag == "--seed") { ok = toLong(value, 0, static_cast<long long>(numeric_limits<unsigned>::max()), n); opt.spec.seed = static_cast<unsigned>(n); }
+        else if (flag == "--queries") { ok = toLong(value, 0, 10000000, n); opt.queries = static_cast<int>(n); }
+        else if (flag == "--crud") { ok = toLong(value, 0, 10000000, n); opt.crudOps = static_cast<int>(n); }
+        else if (flag == "--repeats") { ok = toLong(value, 1, 1000, n); opt.loadRepeats = static_cast<int>(n); }
+        else if (flag == "--threads") { ok = toLong(value, 0, 1024, n); opt.maxThreads = static_cast<int>(n); }
+        else if (flag == "--inter-island") {
+            try {
+                size_t used = 0;
+                opt.spec.interIslandShare = stod(value, &used);
+                ok = used == value.size() && opt.spec.interIslandShare >= 0 && opt.spec.interIslandShare <= 1;
+            } catch (const logic_error&) {
+                ok = false;
+            }
+        }
+        else if (flag == "--dir") opt.workDir = value;
+        else if (flag == "--out") opt.outFile = value;
+        else return false;
+        if (!ok) {
+            cerr << Color::RED << "Invalid value for " << flag << ": " << value << Color::RESET << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+void printBenchmarkUsage() {
+    cerr << "Usage:\n"
+         << "  maps --bench    [--locations N] [--routes N] [--islands N] [--inter-island F] [--seed N]\n"
+         << "                  [--queries N] [--crud N] [--repeats N] [--threads N] [--dir PATH] [--out FILE]\n"
+         << "  maps --bench --existing [--dir PATH] [...]   (benchmark PATH/input, default ..)\n"
+         << "  maps --generate [--locations N] [--routes N] [--islands N] [--inter-island F] [--seed N] --dir PATH\n";
+}
+
+// =================================================================================
+// 7. MAIN PROGRAM FLOW (CLI)
+// =================================================================================
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string mode = argv[1];
+        BenchmarkOptions opt;
+        if ((mode != "--bench" && mode != "--generate") || !parseBenchmarkArgs(argc, argv, opt)) {
+            printBenchmarkUsage();
+            return 2;
+        }
+        try {
+            if (mode == "--bench") return runBenchmark(opt);
+            if (opt.workDir.empty()) {
+                printBenchmarkUsage();
+                return 2;
+            }
+            generateSyntheticNetwork(opt.spec, opt.workDir);
+            cout << "Generated " << opt.spec.locations << " locations and " << opt.spec.routes << " routes under " << (opt.workDir / "input").string() << endl;
+            return 0;
+        } catch (const exception& e) {
+            cerr << Color::RED << "Benchmark failed: " << e.what() << Color::RESET << endl;
+            return 1;
+        }
+    }
+
     FileManager fileManager;
     Graph transportationSystem;
     DecisionTree preferenceFinder;
+    OverlayRouter overlayRouter(transportationSystem);
     vector<vector<shared_ptr<const Route>>> pathHistory;
+    bool traceNextQuery = false;
+    int traceCount = 0;
 
     cli_printHeader();
 
@@ -736,15 +2497,18 @@ int main() {
                 case 7: cli_deleteRoute(transportationSystem); break;
                 case 8: {
                     UserPreferences prefs = preferenceFinder.run();
-                    transportationSystem.printAllLocations();
                     int startId = 0, goalId = 0;
-                    cout << "Enter Start ID: "; cin >> startId;
-                    cout << "Enter Goal ID: "; cin >> goalId;
+                    cli_selectStops(transportationSystem, startId, goalId);
                     if (transportationSystem.isValidLocation(startId) && transportationSystem.isValidLocation(goalId)) {
-                        vector<shared_ptr<const Route>> path = transportationSystem.findShortestPath(startId, goalId, prefs);
+                        SearchTrace trace;
+                        vector<shared_ptr<const Route>> path = transportationSystem.findShortestPath(startId, goalId, prefs, traceNextQuery ? &trace : nullptr);
+                        if (traceNextQuery) {
+                            fileManager.saveTrace(transportationSystem, trace, "trace_" + to_string(++traceCount) + ".csv");
+                            traceNextQuery = false;
+                        }
                         if (!path.empty()) {
                             pathHistory.push_back(path);
-                            cout << fileManager.formatTxtOutputForConsole(path);
+                            fileManager.printPath(path);
                         }
                     } else {
                         cout << Color::RED << "Invalid location ID(s).\n" << Color::RESET;
@@ -761,8 +2525,7 @@ int main() {
                         cout << Color::YELLOW << "No path recommended yet.\n" << Color::RESET;
                     } else {
                         string f = "output_last";
-                        // Using the correct formatter for each file type
-                        fileManager.saveOutput(f, fileManager.formatTxtOutputForFile(pathHistory.back()), fileManager.formatCsvOutput(pathHistory.back()));
+                        fileManager.savePaths(f, prev(pathHistory.end()), pathHistory.end());
                     }
                     break;
                 }
@@ -773,12 +2536,7 @@ int main() {
                         string f;
                         cout << "Base name for files: ";
                         cin >> f;
-                        stringstream t, c;
-                        for (const auto& p : pathHistory) {
-                            t << fileManager.formatTxtOutputForFile(p); // Use file-safe formatter
-                            c << fileManager.formatCsvOutput(p);
-                        }
-                        fileManager.saveOutput(f, t.str(), c.str());
+                        fileManager.savePaths(f, pathHistory.begin(), pathHistory.end());
                     }
                     break;
                 }
@@ -791,6 +2549,24 @@ int main() {
                     fileManager.deleteFile();
                     break;
                 }
+                case 15: cli_findNearestLocations(transportationSystem); break;
+                case 16: cli_showStatistics(fileManager, traceNextQuery); break;
+                case 17: {
+                    UserPreferences prefs = preferenceFinder.run();
+                    int startId = 0, goalId = 0;
+                    cli_selectStops(transportationSystem, startId, goalId);
+                    if (transportationSystem.isValidLocation(startId) && transportationSystem.isValidLocation(goalId)) {
+                        cout << "\nSearching " << overlayRouter.getCellCount() << " island cells...\n";
+                        vector<shared_ptr<const Route>> path = overlayRouter.findShortestPath(startId, goalId, prefs);
+                        if (!path.empty()) {
+                            pathHistory.push_back(path);
+                            fileManager.printPath(path);
+                        }
+                    } else {
+                        cout << Color::RED << "Invalid location ID(s).\n" << Color::RESET;
+                    }
+                    break;
+                }
                 case 0:
                     cout << Color::CYAN << "Exiting program. Goodbye!" << Color::RESET << endl;
                     break;